@@ -76,9 +76,18 @@ void setup()
 {
     powerupMillis = millis();
     
+    #ifdef FC_HAVE_SNIFFER
+    // Buffer for DMX monitor records; must be set before begin()
+    Serial.setTxBufferSize(4096);
+    #endif
+    #ifdef FC_SERIAL_BAUD
+    Serial.begin(FC_SERIAL_BAUD);
+    #else
     Serial.begin(115200);
+    #endif
     Serial.println();
 
+    settings_load();
     dmx_boot();
     settings_setup();
     dmx_setup();
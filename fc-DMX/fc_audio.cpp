@@ -0,0 +1,411 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#ifdef FC_HAVE_AUDIO
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+#include <driver/i2s.h>
+
+#include "fc_audio.h"
+#include "fc_settings.h"
+
+/*
+ * DMX-triggered sound playback
+ *
+ * Sounds are WAV files (PCM, 16 bit, mono or stereo, any sample rate)
+ * named "/snd001.wav" to "/snd032.wav" on the SD card. 
+ *
+ * At boot, the header of each file is parsed, and the first block of
+ * audio data is loaded into RAM. A trigger hands the sound number to
+ * the audio task (never blocking the DMX loop), which queues the 
+ * preloaded block to the I2S DMA buffers right away and only then 
+ * opens the file and streams the rest. While the file is opened, the
+ * output is fed from the DMA buffers only (queuing blocks once they
+ * are full): 1024 frames, ie 23ms at 44.1kHz.
+ *
+ * The task waits for room in the DMA buffers for AUD_WAIT at most,
+ * and checks for a new trigger in between; a retrigger or stop is
+ * therefore picked up within AUD_WAIT or one SD read.
+ *
+ * The recorder uses the SD card from its own task; the audio task
+ * holds the SD lock for each file operation (see sd_lock()). A
+ * recorder write in progress delays the next read like a slow read.
+ */
+
+#define AUD_MAX_SOUNDS  32
+#define AUD_PRELOAD     4096      // bytes of audio data kept in RAM per sound
+#define AUD_CHUNK       512       // bytes read from SD per step
+#define AUD_PORT        I2S_NUM_0
+#define AUD_DMA_BUFS    8         // must at least cover the time to open
+#define AUD_DMA_LEN     128       // frames per DMA buffer
+#define AUD_WAIT        pdMS_TO_TICKS(1)
+#define AUD_TAIL        20000     // us; one DMA buffer at 8kHz is 16ms
+
+#define AUD_NOREQ       -1
+
+typedef struct {
+    uint32_t dataOffs;
+    uint32_t dataLen;
+    uint32_t rate;
+    uint8_t  chans;
+    uint32_t preLen;
+    uint8_t  *pre;
+} sound_t;
+
+static sound_t *sounds[AUD_MAX_SOUNDS];
+
+static TaskHandle_t      audTask = NULL;
+static volatile int16_t  audReq = AUD_NOREQ;
+static volatile uint8_t  audVol = 255;
+static volatile unsigned long audReqTime;
+static volatile bool     audBusy = false;
+static volatile unsigned long audEnd;
+
+// Stereo output buffer; mono input is doubled
+static int16_t audOut[AUD_CHUNK];
+
+static void audioTaskFunc(void *parm);
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t rd16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static sound_t *loadSound(const char *fn)
+{
+    uint8_t  hdr[16];
+    uint32_t clen, pos = 12;
+    sound_t  snd = {}, *res;
+    bool     haveFmt = false;
+    
+    File myFile = SD.open(fn, FILE_READ);
+
+    if(!myFile)
+        return NULL;
+
+    if(myFile.read(hdr, 12) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+        Serial.printf("Audio: %s: Not a WAV file\n", fn);
+        myFile.close();
+        return NULL;
+    }
+
+    // Walk chunks until "data"
+    for(;;) {
+        if(myFile.read(hdr, 8) != 8)
+            break;
+        clen = rd32(hdr + 4);
+        pos += 8;
+        if(!memcmp(hdr, "fmt ", 4)) {
+            if(clen < 16 || myFile.read(hdr, 16) != 16)
+                break;
+            if(rd16(hdr) != 1 || rd16(hdr + 14) != 16 || rd16(hdr + 2) < 1 || rd16(hdr + 2) > 2) {
+                Serial.printf("Audio: %s: Only 16 bit PCM mono/stereo supported\n", fn);
+                break;
+            }
+            snd.chans = rd16(hdr + 2);
+            snd.rate = rd32(hdr + 4);
+            haveFmt = true;
+        } else if(!memcmp(hdr, "data", 4)) {
+            if(!haveFmt)
+                break;
+            snd.dataOffs = pos;
+            snd.dataLen = clen & ~3;
+            snd.preLen = min(snd.dataLen, (uint32_t)AUD_PRELOAD);
+            if(!(snd.pre = (uint8_t *)malloc(snd.preLen)))
+                break;
+            myFile.seek(pos);
+            if(myFile.read(snd.pre, snd.preLen) != snd.preLen) {
+                free(snd.pre);
+                break;
+            }
+            myFile.close();
+            if((res = (sound_t *)malloc(sizeof(sound_t)))) {
+                *res = snd;
+            } else {
+                free(snd.pre);
+            }
+            return res;
+        }
+        pos += (clen + 1) & ~1;
+        myFile.seek(pos);
+    }
+
+    myFile.close();
+    
+    return NULL;
+}
+
+void audio_setup()
+{
+    i2s_config_t cfg;
+    i2s_pin_config_t pins;
+    char fn[16];
+    int num = 0;
+
+    if(!haveSD) {
+        Serial.println("Audio: No SD card, audio disabled");
+        return;
+    }
+
+    for(int i = 0; i < AUD_MAX_SOUNDS; i++) {
+        sprintf(fn, "/snd%03d.wav", i + 1);
+        if((sounds[i] = loadSound(fn))) num++;
+    }
+
+    Serial.printf("Audio: %d sounds found\n", num);
+
+    if(!num)
+        return;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+    cfg.sample_rate = 44100;
+    cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    cfg.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+    cfg.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    cfg.dma_buf_count = AUD_DMA_BUFS;
+    cfg.dma_buf_len = AUD_DMA_LEN;
+    cfg.tx_desc_auto_clear = true;     // Output silence when idle/underrun
+
+    memset(&pins, 0, sizeof(pins));
+    pins.mck_io_num = I2S_PIN_NO_CHANGE;
+    pins.bck_io_num = I2S_BCLK_PIN;
+    pins.ws_io_num = I2S_LRCLK_PIN;
+    pins.data_out_num = I2S_DIN_PIN;
+    pins.data_in_num = I2S_PIN_NO_CHANGE;
+
+    if(i2s_driver_install(AUD_PORT, &cfg, 0, NULL) != ESP_OK ||
+       i2s_set_pin(AUD_PORT, &pins) != ESP_OK) {
+        Serial.println("Audio: Failed to set up I2S");
+        return;
+    }
+
+    xTaskCreatePinnedToCore(audioTaskFunc, "audio", 4096, NULL, 5, &audTask, 0);
+}
+
+/*
+ * Start sound num (1-AUD_MAX_SOUNDS), 0 = stop. Never blocks.
+ */
+void audio_play(uint8_t num)
+{
+    if(!audTask)
+        return;
+
+    audReqTime = micros();
+    if(num) audBusy = true;
+    audReq = num;
+    xTaskNotifyGive(audTask);
+}
+
+void audio_volume(uint8_t vol)
+{
+    audVol = vol;
+}
+
+/*
+ * True while a sound is playing, including what is left in
+ * the DMA buffers after the end of the file
+ */
+bool audio_active()
+{
+    return audBusy || (long)(micros() - audEnd) < 0;
+}
+
+// Sound ended or stopped; the DMA plays out for another leftUs,
+// plus AUD_TAIL for the DMA buffer being played out
+static void aud_done(int64_t leftUs)
+{
+    audEnd = micros() + (leftUs > 0 ? (unsigned long)leftUs : 0) + AUD_TAIL;
+    audBusy = false;
+}
+
+// Queue len bytes of audOut for DMA; returns false if a new
+// request came in before all was queued
+static bool aud_write(uint32_t len)
+{
+    const uint8_t *p = (const uint8_t *)audOut;
+    size_t written;
+
+    while(len) {
+        if(audReq != AUD_NOREQ)
+            return false;
+        written = 0;
+        i2s_write(AUD_PORT, p, len, &written, AUD_WAIT);
+        p += written;
+        len -= written;
+    }
+
+    return true;
+}
+
+// Convert to stereo, apply volume, queue for DMA; returns false
+// if interrupted by a new request
+static bool aud_out(const sound_t *snd, const uint8_t *buf, uint32_t len)
+{
+    const int16_t *in = (const int16_t *)buf;
+    int32_t vol = audVol;
+    uint32_t frames, o;
+
+    if(snd->chans == 1) {
+        while(len) {
+            frames = min(len / 2, (uint32_t)(AUD_CHUNK / 2));
+            for(uint32_t i = 0; i < frames; i++) {
+                int16_t smp = (int16_t)((in[i] * vol) >> 8);
+                audOut[i * 2] = smp;
+                audOut[i * 2 + 1] = smp;
+            }
+            if(!aud_write(frames * 4))
+                return false;
+            in += frames;
+            len -= frames * 2;
+        }
+    } else {
+        while(len) {
+            frames = min(len / 4, (uint32_t)(AUD_CHUNK / 2));
+            for(o = 0; o < frames * 2; o++) {
+                audOut[o] = (int16_t)((in[o] * vol) >> 8);
+            }
+            if(!aud_write(frames * 4))
+                return false;
+            in += frames * 2;
+            len -= frames * 4;
+        }
+    }
+
+    return true;
+}
+
+static void aud_close(File &f)
+{
+    sd_lock();
+    f.close();
+    sd_unlock();
+}
+
+static void audioTaskFunc(void *parm)
+{
+    static uint8_t buf[AUD_CHUNK];
+    sound_t  *cur = NULL;
+    File     myFile;
+    uint32_t pos = 0, curRate = 0, curChans = 0;
+    uint32_t underruns = 0;
+    uint64_t queuedUs = 0;
+    int64_t  startUs = 0;
+    int16_t  req;
+    int      n, q;
+    bool     ok;
+
+    (void)parm;
+
+    for(;;) {
+
+        if(!cur) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        req = __atomic_exchange_n(&audReq, (int16_t)AUD_NOREQ, __ATOMIC_ACQ_REL);
+
+        if(req != AUD_NOREQ) {
+
+            if(cur) {
+                aud_close(myFile);
+                i2s_zero_dma_buffer(AUD_PORT);
+                cur = NULL;
+            }
+
+            if(req > 0 && req <= AUD_MAX_SOUNDS && sounds[req - 1]) {
+                cur = sounds[req - 1];
+                audBusy = true;
+                if(cur->rate != curRate || cur->chans != curChans) {
+                    i2s_set_clk(AUD_PORT, cur->rate, I2S_BITS_PER_SAMPLE_16BIT, I2S_CHANNEL_STEREO);
+                    curRate = cur->rate;
+                    curChans = cur->chans;
+                }
+                startUs = esp_timer_get_time();
+                if(!aud_out(cur, cur->pre, cur->preLen))
+                    continue;
+                #ifdef FC_DBG
+                Serial.printf("Audio: Trigger to sound queued: %lu us\n", micros() - audReqTime);
+                #endif
+                queuedUs = (uint64_t)cur->preLen * 1000000 / (cur->rate * cur->chans * 2);
+                underruns = 0;
+                pos = cur->preLen;
+                if(pos < cur->dataLen) {
+                    char fn[16];
+                    sprintf(fn, "/snd%03d.wav", req);
+                    sd_lock();
+                    myFile = SD.open(fn, FILE_READ);
+                    ok = myFile && myFile.seek(cur->dataOffs + pos);
+                    sd_unlock();
+                    if(!ok) {
+                        aud_close(myFile);
+                        cur = NULL;
+                        aud_done(startUs + (int64_t)queuedUs - esp_timer_get_time());
+                    }
+                }
+            } else {
+                aud_done(0);
+            }
+            continue;
+        }
+
+        if(!cur)
+            continue;
+
+        if(pos >= cur->dataLen) {
+            aud_close(myFile);
+            cur = NULL;
+            aud_done(startUs + (int64_t)queuedUs - esp_timer_get_time());
+            if(underruns) {
+                Serial.printf("Audio: %lu buffer underruns\n", (unsigned long)underruns);
+            }
+            continue;
+        }
+
+        sd_lock();
+        n = myFile.read(buf, min((uint32_t)AUD_CHUNK, cur->dataLen - pos));
+        sd_unlock();
+        // Only multiples of 4 bytes are queued; after a short read,
+        // reading continues at the first byte not queued. Less than
+        // 4 bytes means the file is shorter than its header says.
+        q = (n > 0) ? (n & ~3) : 0;
+        if(!q) {
+            aud_close(myFile);
+            cur = NULL;
+            aud_done(startUs + (int64_t)queuedUs - esp_timer_get_time());
+            continue;
+        }
+        if(q != n) {
+            sd_lock();
+            myFile.seek(cur->dataOffs + pos + q);
+            sd_unlock();
+        }
+
+        // If more time has passed than audio was queued, the DMA ran dry
+        if(esp_timer_get_time() - startUs > (int64_t)queuedUs) {
+            underruns++;
+            startUs = esp_timer_get_time() - queuedUs;
+        }
+
+        if(!aud_out(cur, buf, q))
+            continue;
+        queuedUs += (uint64_t)q * 1000000 / (cur->rate * cur->chans * 2);
+        pos += q;
+    }
+}
+
+#endif  // FC_HAVE_AUDIO
@@ -0,0 +1,22 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_AUDIO_H
+#define _FC_AUDIO_H
+
+#ifdef FC_HAVE_AUDIO
+
+void audio_setup();
+
+void audio_play(uint8_t num);
+void audio_volume(uint8_t vol);
+bool audio_active();
+
+#endif
+
+#endif
@@ -12,7 +12,19 @@
 #include <esp_dmx.h>
 
 #include "fc_dmx.h"
+#include "fc_settings.h"
 #include "fcdisplay.h"
+#include "fc_gen.h"
+#include "fc_frame.h"
+#include "fc_idle.h"
+#include "fc_record.h"
+#include "fc_log.h"
+#include "fc_latency.h"
+#include "fc_audio.h"
+#include "fc_inject.h"
+#include "fc_look.h"
+#include "fc_sniff.h"
+#include "fc_scene.h"
 
 // The timer to use for the FC chase
 #define FC_TIMER_NO   3    //  0 and 3 ok; 0 => group 0, num 0; 3 => group 1, num 1
@@ -20,16 +32,18 @@
 //  group = dmx_port / 2;   port=1 -> 1/2 = 0 > group 0
 //  num   = dmx_port % 2;   port=1 -> 1%2 = 1 > num   1
 
-// CenterLED PWM properties
-#define CLED_FREQ     5000
+// CenterLED PWM properties (frequency: see settings)
 #define CLED_CHANNEL  0
 #define CLED_RES      8
 
-// BoxLED PWM properties
-#define BLED_FREQ     5000
+// BoxLED PWM properties (frequency: see settings)
 #define BLED_CHANNEL  1
 #define BLED_RES      8
 
+// Strobe timers (0 and 1 are unused by DMX and FC chase)
+#define CLED_STROBE_TIMER 0
+#define BLED_STROBE_TIMER 1
+
 #define POT_GRAN       45
 static const uint16_t potSpeeds[POT_GRAN] = {
       2,   3,   3,   4,   5,   6,   7,   8,   9,  10,
@@ -57,38 +71,207 @@ dmx_port_t dmxPort = 1;
 
 dmx_packet_t packet;
 
-uint8_t data[DMX_PACKET_SIZE];
+// DMX address, personality at boot (can be changed through
+// RDM), verification: see settings
 
-#define DMX_ADDRESS   47
-#define DMX_CHANNELS  10
+#define DMX_VERIFY_VALUE   100   // Value of DMX_VERIFY_CHANNEL
 
-#define DMX_VERIFY_CHANNEL 46    // must be set to DMX_VERIFY_VALUE
-#define DMX_VERIFY_VALUE   100 
+// DMX is considered disconnected after this many ms without a packet
+#define DMX_TIMEOUT  1250
 
-#if defined(DMX_USE_VERIFY) && (DMX_ADDRESS < DMX_VERIFY_CHANNEL)
-#define DMX_SLOTS_TO_RECEIVE (DMX_VERIFY_CHANNEL + 1)
-#else
-#define DMX_SLOTS_TO_RECEIVE (DMX_ADDRESS + DMX_CHANNELS)
-#endif
+// Idle power save: While idle, block for max FC_IDLE_WAIT ms
+// waiting for DMX packets (see fc_idle.h for when idle is entered)
+#define FC_IDLE_WAIT    100
+#define FC_IDLE_CPU_MHZ 80
+
+// Chase sync: Sync is lost after this many ms without change
+// in the sync channel. Rate correction is err >> SYNC_KP_SHIFT
+// plus the integral of err >> SYNC_KI_SHIFT; max SYNC_MAX_ADJ/256.
+#define SYNC_TIMEOUT   2000
+#define SYNC_KP_SHIFT  7
+#define SYNC_KI_SHIFT  12
+#define SYNC_MAX_ADJ   64
+
+// Play back recording after this many ms without DMX
+#define PLAY_DELAY   3000
+
+// Scene crossfades: Fade time unit (ch23) and tick length in ms
+#define SCENE_FADE_UNIT 100
+#define SCENE_TICK_MS   20
+
+// Restored look: Fade Center/Box LEDs to the first new look
+// over this many ms
+#define LOOK_FADE_MS 1000
 
 // DMX channels
-#define FC_BASE DMX_ADDRESS
+static int fcBase;
+static int dmxSlotsToReceive;
 
-uint8_t cache[DMX_CHANNELS];
+// Received frames (see fc_frame.h)
+static dmxFrame  frames[2];
+static dmxFrame *frmLive = &frames[0];
+static dmxFrame *frmNext = &frames[1];
+static bool      frameForce = true;
 
 unsigned long powerupMillis;
 
 static bool          dmxIsConnected = false;
 static unsigned long lastDMXpacket;
 
-static void setDisplay(int base);
+#ifdef FC_HAVE_AUDIO
+static uint8_t       lastSound = 0;
+#endif
 
-static void invalidateCache()
+static uint8_t       lastSpecial = 0;
+
+static bool          syncActive = false;
+static bool          syncSeeded = false;
+static uint8_t       syncLastRef = 0;
+static unsigned long syncLastUpdate;
+static int32_t       syncInteg = 0;
+
+#ifdef FC_HAVE_INJECT
+static bool          injActive = false;
+static unsigned long lastInjFrame;
+#endif
+
+#ifdef FC_LATENCY_STATS
+static unsigned long latPacketTime = 0;     // 0 = not a live DMX frame
+#endif
+
+#ifdef FC_HAVE_SCENES
+// Channels that are crossfaded; all others switch at the start of a fade
+static const uint8_t sceneFadeChans[] = { 0, 1, 2, 16 };
+#define SCENE_NUM_FADE (int)(sizeof(sceneFadeChans) / sizeof(sceneFadeChans[0]))
+static bool          sceneInit = false;
+static uint8_t       sceneNum = 0;              // Selected scene, 0 = live
+static bool          sceneActive = false;       // Scene (not live) is shown
+static uint8_t       sceneLastStore;
+static uint8_t       sceneWin[DMX_CHANNELS];    // Output window
+static uint8_t       sceneTarget[SCENE_CHANNELS];
+static int32_t       sceneVal[SCENE_NUM_FADE];  // 16.16 fixed point
+static int32_t       sceneStep[SCENE_NUM_FADE];
+static uint16_t      sceneTicks = 0;            // Remaining fade ticks
+static unsigned long sceneLastTick;
+static uint8_t       dispWin[DMX_CHANNELS];     // Window currently shown
+#endif
+
+#ifdef FC_LOOK_RESTORE
+static bool          haveLook = false;
+static uint8_t       lookWin[DMX_CHANNELS];
+static uint16_t      lookPhase;
+static bool          lookFadePending = false;
+static bool          lookFading = false;
+static unsigned long lookFadeStart;
+static int           fadeFromC, fadeFromB;
+static int           fadeToC, fadeToB;
+#endif
+
+#ifdef FC_IDLE_POWERSAVE
+static bool          isIdle = false;
+static unsigned long lastChange = 0;
+static uint32_t      normalCpuMhz;
+#endif
+
+static void setDisplay(const uint8_t *win);
+static void frameRead(dmxFrame *f, int size);
+static void processFrame();
+static void applyWindow(const uint8_t *win);
+#ifdef FC_HAVE_SCENES
+static void sceneFade();
+#endif
+static void chaseSyncOff();
+
+#ifdef FC_LOOK_RESTORE
+// Blend from the restored look's PWM values to the new ones
+static void lookFade(int *cbri, int *bbri)
 {
-    for(int i = 0; i < DMX_CHANNELS; i++) {
-        cache[i] = rand() % 255;
+    unsigned long t = millis() - lookFadeStart;
+
+    if(t >= LOOK_FADE_MS) {
+        lookFading = false;
+        return;
     }
+
+    *cbri = fadeFromC + (*cbri - fadeFromC) * (int)t / LOOK_FADE_MS;
+    *bbri = fadeFromB + (*bbri - fadeFromB) * (int)t / LOOK_FADE_MS;
+}
+
+static uint16_t chasePhase()
+{
+    return fcLEDs.getPhase();
 }
+#endif
+
+// Apply the next frame even if unchanged
+static void invalidateCache()
+{
+    frameForce = true;
+}
+
+#ifdef FC_IDLE_POWERSAVE
+/*
+ * Idle mode: Entered when all outputs are static (no chase running,
+ * no special sequence, all patterns latched) and no output changed 
+ * for FC_IDLE_DELAY ms. While idle, the FC LED timer is stopped, the
+ * CPU is clocked down, and loop() blocks waiting for the next DMX
+ * packet instead of busy-polling.
+ * The APB clock (UART, LEDC, timers) is unaffected by the CPU clock
+ * change, so DMX reception and the PWM outputs keep running.
+ */
+static bool idleAllowed(unsigned long now)
+{
+    bool recBusy = false, audBusy = false;
+    
+    #ifdef FC_HAVE_RECORDER
+    recBusy = rec_isRecording() || play_isPlaying();
+    #endif
+
+    #ifdef FC_HAVE_AUDIO
+    audBusy = audio_active();
+    #endif
+
+    #ifdef FC_HAVE_INJECT
+    return fcidle_allowed(now, lastChange, fcLEDs.isStatic(), recBusy, audBusy, injActive, lastInjFrame);
+    #else
+    return fcidle_allowed(now, lastChange, fcLEDs.isStatic(), recBusy, audBusy, false, 0);
+    #endif
+}
+
+static void enterIdle()
+{
+    if(isIdle)
+        return;
+
+    fcLEDs.idle(true);
+    setCpuFrequencyMhz(FC_IDLE_CPU_MHZ);
+    isIdle = true;
+    
+    #ifdef FC_DBG
+    log_msg(LOG_IDLE_ENTER);
+    #endif
+}
+
+static void leaveIdle()
+{
+    #ifdef FC_DBG
+    unsigned long now = micros();
+    #endif
+    
+    lastChange = millis();
+    
+    if(!isIdle)
+        return;
+
+    setCpuFrequencyMhz(normalCpuMhz);
+    fcLEDs.idle(false);
+    isIdle = false;
+
+    #ifdef FC_DBG
+    log_msg(LOG_IDLE_LEAVE, micros() - now);
+    #endif
+}
+#endif
 
 /*********************************************************************************
  * 
@@ -99,15 +282,29 @@ static void invalidateCache()
 void dmx_boot() 
 {
     // Boot center LED here (is for some reason on after reset)
-    centerLED.begin(CLED_CHANNEL, CLED_FREQ, CLED_RES);
+    centerLED.begin(CLED_CHANNEL, settings.cledFreq, CLED_RES);
 
     // Boot remaining display LEDs (but keep them dark)
-    boxLED.begin(BLED_CHANNEL, BLED_FREQ, BLED_RES, 255);
+    boxLED.begin(BLED_CHANNEL, settings.bledFreq, BLED_RES, 255);
 
     // Make sure LEDs are off
     centerLED.setDC(0);
     boxLED.setDC(0);
 
+    #ifdef FC_LOOK_RESTORE
+    // Restore last look: Center/Box LEDs right away, the rest
+    // (which needs fcLEDs and the DMX driver) in dmx_setup()
+    if((haveLook = look_load(lookWin, &lookPhase))) {
+        if(lookWin[0]) {
+            centerLED.setDC(lookWin[1] * lookWin[0] / 255);
+            boxLED.setDC(lookWin[2] * lookWin[0] / 255);
+        }
+        #ifdef FC_DBG
+        Serial.printf("Look restored %lu ms after power-up\n", millis());
+        #endif
+    }
+    #endif
+
     // Do NOT boot fcLEDs here. Might disturb 
     // firmware update.
 
@@ -138,21 +335,101 @@ void dmx_setup()
       .queue_size_max = 32
     };
     dmx_personality_t personalities[] = {
-        {DMX_CHANNELS, "FC Personality"}
+        {DMX_CHANNELS_STD, "FC Personality"},
+        {DMX_CHANNELS,     "FC Extended"}
     };
-    int personality_count = 1;
+    int personality_count = 2;
+
+    // Config file on SD might have changed PWM frequencies
+    centerLED.setFreq(settings.cledFreq);
+    boxLED.setFreq(settings.bledFreq);
 
     // Boot FC leds
     fcLEDs.begin();
 
+    // Set up strobe timers
+    centerLED.beginStrobe(CLED_STROBE_TIMER);
+    boxLED.beginStrobe(BLED_STROBE_TIMER);
+
     Serial.println(F("Flux Capacitor DMX version " FC_VERSION " " FC_VERSION_EXTRA));
     Serial.println(F("(C) 2024 Thomas Winischhofer (A10001986)"));
 
+    if(dmx_addressConflict(settings.dmxAddress, settings.personality, settings.useVerify)) {
+        Serial.printf("DMX: Address %d covers verify/record channel, using %d\n", 
+                      settings.dmxAddress, DEF_DMX_ADDRESS);
+        settings.dmxAddress = DEF_DMX_ADDRESS;
+    }
+    fcBase = settings.dmxAddress;
+    // Enough for the Extended personality, which can be selected
+    // through RDM; the Standard one can go up to the last slot
+    dmxSlotsToReceive = fcBase + DMX_CHANNELS;
+    if(dmxSlotsToReceive > DMX_PACKET_SIZE) {
+        dmxSlotsToReceive = DMX_PACKET_SIZE;
+    }
+    if(settings.useVerify && dmxSlotsToReceive <= DMX_VERIFY_CHANNEL) {
+        dmxSlotsToReceive = DMX_VERIFY_CHANNEL + 1;
+    }
+    #ifdef FC_HAVE_RECORDER
+    if(dmxSlotsToReceive <= DMX_RECORD_CHANNEL) {
+        dmxSlotsToReceive = DMX_RECORD_CHANNEL + 1;
+    }
+    #endif
+    #ifdef FC_HAVE_SNIFFER
+    if(settings.monitor) {
+        dmxSlotsToReceive = DMX_PACKET_SIZE;
+    }
+    #endif
+
     invalidateCache();
 
+    #ifdef FC_IDLE_POWERSAVE
+    normalCpuMhz = getCpuFrequencyMhz();
+    lastChange = millis();
+    #endif
+
+    log_setup();
+
     // Start the DMX stuff
     dmx_driver_install(dmxPort, &config, personalities, personality_count);
     dmx_set_pin(dmxPort, transmitPin, receivePin, enablePin);
+    dmx_set_start_address(dmxPort, fcBase);
+    dmx_set_current_personality(dmxPort, settings.personality);
+
+    #ifdef FC_LATENCY_STATS
+    lat_setup(dmxPort);
+    #endif
+
+    #ifdef FC_HAVE_SNIFFER
+    if(settings.monitor) {
+        sniff_setup(dmxPort, DMX_SNIFFER_PIN);
+    }
+    #endif
+
+    #ifdef FC_HAVE_RECORDER
+    rec_setup(DMX_CHANNELS);
+    #endif
+
+    #ifdef FC_HAVE_AUDIO
+    audio_setup();
+    #endif
+
+    #ifdef FC_LOOK_RESTORE
+    look_setup();
+    if(haveLook) {
+        memcpy(frmLive->win, lookWin, DMX_CHANNELS);
+        // Don't retrigger sound, don't take sync value as reference
+        #ifdef FC_HAVE_AUDIO
+        lastSound = lookWin[15];
+        #endif
+        syncLastRef = lookWin[14];
+        syncSeeded = true;
+        lastSpecial = lookWin[20];
+        setDisplay(frmLive->win);
+        fcLEDs.setPhase(lookPhase);
+        frameForce = false;
+        lookFadePending = true;
+    }
+    #endif
 }
 
 
@@ -167,25 +444,65 @@ void dmx_loop()
     #ifdef FC_DBG
     bool isAllZero = true;
     #endif
+    #ifdef FC_IDLE_POWERSAVE
+    TickType_t waitTicks = isIdle ? pdMS_TO_TICKS(FC_IDLE_WAIT) : 0;
+    #else
+    TickType_t waitTicks = 0;
+    #endif
        
-    if(dmx_receive_num(dmxPort, &packet, DMX_SLOTS_TO_RECEIVE, 0)) {
+    if(dmx_receive_num(dmxPort, &packet, dmxSlotsToReceive, waitTicks)) {
+
+        #ifdef FC_HAVE_SNIFFER
+        uint32_t packetTime = micros();
+        #endif
         
         lastDMXpacket = millis();
+
+        #ifdef FC_LATENCY_STATS
+        latPacketTime = micros();
+        #endif
+
+        #ifdef FC_HAVE_RECORDER
+        if(play_isPlaying()) {
+            play_stop();
+            invalidateCache();
+        }
+        #endif
     
         if(!packet.err) {
 
             if(!dmxIsConnected) {
-                Serial.println("DMX is connected");
+                log_msg(LOG_DMX_CONNECTED);
                 dmxIsConnected = true;
             }
       
-            dmx_read(dmxPort, data, packet.size);
+            #ifdef FC_HAVE_SNIFFER
+            if(settings.monitor) {
+                sniff_frame(packet.size, packetTime);
+            }
+            #endif
+
+            frameRead(frmNext, packet.size);
       
-            if(!data[0]) {
+            if(frmNext->startCode) {
+
+                log_msg(LOG_DMX_STARTCODE, frmNext->startCode);
+
+            } else if(settings.useVerify && frmNext->verify != DMX_VERIFY_VALUE) {
+
+                #ifdef FC_DBG
+                Serial.println("Packet failed verification");
+                #endif
+              
+            } else {
               
+                #ifdef FC_HAVE_RECORDER
+                bool doRecord = (frmNext->record >= 128);
+                #endif
+
                 #ifdef FC_DBG1
-                for(int i = DMX_ADDRESS; i < DMX_ADDRESS+DMX_CHANNELS; i++) {
-                   if(data[i]) {
+                for(int i = 0; i < DMX_CHANNELS; i++) {
+                   if(frmNext->win[i]) {
                         isAllZero = false;
                         break;
                    }
@@ -195,30 +512,121 @@ void dmx_loop()
                 }
                 #endif
               
-                if(memcmp(cache, data + FC_BASE, DMX_CHANNELS)) {
-                    setDisplay(FC_BASE);
-                    memcpy(cache, data + FC_BASE, DMX_CHANNELS);
+                processFrame();
+
+                #ifdef FC_HAVE_RECORDER
+                if(doRecord) {
+                    rec_start(frmLive->win);
+                } else {
+                    rec_stop();
                 }
-                
-            } else {
-              
-                Serial.printf("Unrecognized start code %d (0x%02x)", data[0], data[0]);
+                #endif
                 
             }
           
         } else {
             
-            Serial.printf("DMX error: %d\n", packet.err);
+            log_msg(LOG_DMX_ERROR, packet.err);
+
+            #ifdef FC_HAVE_SNIFFER
+            if(settings.monitor) {
+                sniff_error(packet.err, packetTime);
+            }
+            #endif
             
         }
+
+        #ifdef FC_LATENCY_STATS
+        latPacketTime = 0;
+        #endif
         
     } 
 
-    if(dmxIsConnected && (millis() - lastDMXpacket > 1250)) {
-        Serial.println("DMX was disconnected");
+    #ifdef FC_HAVE_INJECT
+    int injLen;
+    if((injLen = inject_loop(frmNext->win, DMX_CHANNELS))) {
+        // Channels not in the injected frame keep their value
+        memcpy(frmNext->win + injLen, frmLive->win + injLen, DMX_CHANNELS - injLen);
+        injActive = true;
+        lastInjFrame = millis();
+        #ifdef FC_HAVE_RECORDER
+        play_stop();
+        #endif
+        processFrame();
+        inject_ack();
+    }
+    #endif
+
+    if(dmxIsConnected && (millis() - lastDMXpacket > DMX_TIMEOUT)) {
+        log_msg(LOG_DMX_DISCONNECTED);
         dmxIsConnected = false;
+        if(settings.lossPolicy == LOSS_BLACKOUT) {
+            memset(frmLive->win, 0, DMX_CHANNELS);
+            #ifdef FC_HAVE_SCENES
+            sceneNum = 0;
+            sceneActive = false;
+            sceneTicks = 0;
+            #endif
+            #ifdef FC_IDLE_POWERSAVE
+            leaveIdle();
+            #endif
+            setDisplay(frmLive->win);
+        }
         invalidateCache();
+        #ifdef FC_HAVE_RECORDER
+        rec_stop();
+        #endif
+    }
+
+    #ifdef FC_HAVE_RECORDER
+    bool doPlay = (!dmxIsConnected && (millis() - lastDMXpacket > PLAY_DELAY));
+    #ifdef FC_HAVE_INJECT
+    if(injActive && (millis() - lastInjFrame <= PLAY_DELAY)) {
+        doPlay = false;
+    }
+    #endif
+    if(doPlay) {
+        if(play_isPlaying() || play_start()) {
+            #ifdef FC_IDLE_POWERSAVE
+            leaveIdle();
+            #endif
+            // Patches the live window in place
+            if(play_loop(frmLive->win)) {
+                applyWindow(frmLive->win);
+            }
+        }
+    }
+    #endif
+
+    #ifdef FC_IDLE_POWERSAVE
+    if(!isIdle && idleAllowed(millis())) {
+        enterIdle();
+    }
+    #endif
+
+    if(syncActive && (millis() - syncLastUpdate > SYNC_TIMEOUT)) {
+        chaseSyncOff();
+    }
+
+    #ifdef FC_HAVE_SCENES
+    if(sceneTicks) {
+        sceneFade();
+    }
+    #endif
+
+    #ifdef FC_LOOK_RESTORE
+    if(lookFading) {
+        int cbri = fadeToC, bbri = fadeToB;
+        lookFade(&cbri, &bbri);
+        if(centerLED.getDC() != (uint32_t)cbri) centerLED.setDC(cbri);
+        if(boxLED.getDC() != (uint32_t)bbri) boxLED.setDC(bbri);
     }
+    look_loop(chasePhase);
+    #endif
+
+    #ifdef FC_LATENCY_STATS
+    lat_loop();
+    #endif
 }
 
 
@@ -229,6 +637,229 @@ void dmx_loop()
  *
  *********************************************************************************/
 
+/*
+ * True if the FC's channels at address would include the verify
+ * channel (if verification is enabled) or the record channel (if
+ * the recorder is compiled in). The FC would then control these
+ * with its own channels.
+ */
+bool dmx_addressConflict(int address, int personality, bool verify)
+{
+    int last = address + DMX_FOOTPRINT(personality) - 1;
+
+    if(verify && address <= DMX_VERIFY_CHANNEL && last >= DMX_VERIFY_CHANNEL)
+        return true;
+
+    #ifdef FC_HAVE_RECORDER
+    if(address <= DMX_RECORD_CHANNEL && last >= DMX_RECORD_CHANNEL)
+        return true;
+    #endif
+
+    return false;
+}
+
+// Channels of the current personality (can be changed through RDM)
+static int winLen()
+{
+    return DMX_FOOTPRINT(dmx_get_current_personality(dmxPort));
+}
+
+/*
+ * Read the slots the FC evaluates from the driver's buffer into f:
+ * The start code, and (if 0) the FC's channels and the verify and
+ * record slots. Channels beyond the end of a short packet keep
+ * their live value.
+ */
+static void frameRead(dmxFrame *f, int size)
+{
+    int len = winLen();
+    int n = size - fcBase;
+
+    f->startCode = dmx_read_slot(dmxPort, 0);
+    if(f->startCode)
+        return;
+
+    if(n > len) n = len;
+    if(n > 0) {
+        dmx_read_offset(dmxPort, fcBase, f->win, n);
+    } else {
+        n = 0;
+    }
+    if(n < len) {
+        memcpy(f->win + n, frmLive->win + n, len - n);
+    }
+
+    if(settings.useVerify) {
+        f->verify = (size > DMX_VERIFY_CHANNEL) ? dmx_read_slot(dmxPort, DMX_VERIFY_CHANNEL) : 0;
+    }
+    #ifdef FC_HAVE_RECORDER
+    f->record = (size > DMX_RECORD_CHANNEL) ? dmx_read_slot(dmxPort, DMX_RECORD_CHANNEL) : 0;
+    #endif
+}
+
+/*
+ * Apply the window in frmNext if the current personality's channels
+ * differ from the live ones. The rest of the window belongs to other
+ * fixtures (Standard personality) and is cleared, so it doesn't
+ * end up in recordings or the stored look.
+ */
+static void processFrame()
+{
+    int len = winLen();
+    uint32_t changed;
+    dmxFrame *t;
+
+    if(len < DMX_CHANNELS) {
+        memset(frmNext->win + len, 0, DMX_CHANNELS - len);
+    }
+    changed = fcframe_diff(frmNext, frmLive) & (0xffffffffUL >> (32 - len));
+
+    if(!changed && !frameForce) {
+        #ifdef FC_LOOK_RESTORE
+        // First frame equals the restored look: Nothing to fade,
+        // later changes must not fade either
+        lookFadePending = false;
+        #endif
+        return;
+    }
+
+    frameForce = false;
+
+    // The old live window is reused for the next frame
+    t = frmLive;
+    frmLive = frmNext;
+    frmNext = t;
+
+    #ifdef FC_IDLE_POWERSAVE
+    leaveIdle();
+    #endif
+    applyWindow(frmLive->win);
+    #ifdef FC_HAVE_RECORDER
+    rec_frame(frmLive->win);
+    #endif
+}
+
+#ifdef FC_HAVE_SCENES
+/*
+ * Scenes
+ * 
+ * Recalling a scene (or going back to live) prepares a fixed-point 
+ * step per crossfaded channel, starting from the currently shown
+ * values. sceneFade() then only adds these steps once per 
+ * SCENE_TICK_MS, until the target is reached.
+ */
+static void sceneRecall(uint8_t fade)
+{
+    uint16_t ticks = (uint32_t)fade * SCENE_FADE_UNIT / SCENE_TICK_MS;
+
+    memcpy(sceneWin, dispWin, DMX_CHANNELS);
+    memcpy(sceneWin, sceneTarget, SCENE_CHANNELS);
+
+    if(ticks) {
+        for(int i = 0; i < SCENE_NUM_FADE; i++) {
+            uint8_t c = sceneFadeChans[i];
+            sceneWin[c] = dispWin[c];
+            sceneVal[i] = (int32_t)dispWin[c] << 16;
+            sceneStep[i] = (((int32_t)sceneTarget[c] << 16) - sceneVal[i]) / ticks;
+        }
+    }
+
+    sceneTicks = ticks;
+    sceneLastTick = millis();
+
+    if(sceneActive || ticks) {
+        setDisplay(sceneWin);
+    } else {
+        setDisplay(frmLive->win);
+    }
+}
+
+static void sceneFade()
+{
+    unsigned long now = millis();
+
+    if(now - sceneLastTick < SCENE_TICK_MS)
+        return;
+
+    // Catch up if the loop was busy
+    do {
+        for(int i = 0; i < SCENE_NUM_FADE; i++) {
+            sceneVal[i] += sceneStep[i];
+        }
+        sceneLastTick += SCENE_TICK_MS;
+    } while(--sceneTicks && (now - sceneLastTick >= SCENE_TICK_MS));
+
+    for(int i = 0; i < SCENE_NUM_FADE; i++) {
+        uint8_t c = sceneFadeChans[i];
+        sceneWin[c] = sceneTicks ? (sceneVal[i] >> 16) : sceneTarget[c];
+    }
+
+    #ifdef FC_IDLE_POWERSAVE
+    leaveIdle();
+    #endif
+
+    if(sceneTicks || sceneActive) {
+        setDisplay(sceneWin);
+    } else {
+        // Back to live: Show latest values
+        setDisplay(frmLive->win);
+    }
+}
+
+/*
+ * Evaluate scene channels of a live window; returns true if 
+ * the scene layer determines the output.
+ */
+static bool sceneControl(const uint8_t *live)
+{
+    uint8_t num = live[21], store = live[23];
+
+    // Store only on change, not on the first frame. A played back
+    // recording never stores (it would rewrite the scenes on every
+    // loop); the first live frame after it doesn't either.
+    bool canStore = true;
+    #ifdef FC_HAVE_RECORDER
+    canStore = !play_isPlaying();
+    #endif
+    if(!sceneInit || !canStore) {
+        sceneLastStore = store;
+        sceneInit = canStore;
+    } else if(store != sceneLastStore) {
+        sceneLastStore = store;
+        if(store) {
+            scene_store(store, live);
+        }
+    }
+
+    if(num > SCENE_MAX) num = 0;
+
+    if(num != sceneNum) {
+        sceneNum = num;
+        sceneActive = (num && scene_load(num, sceneTarget));
+        if(!sceneActive) {
+            memcpy(sceneTarget, live, SCENE_CHANNELS);
+        }
+        sceneRecall(live[22]);
+        return true;
+    }
+
+    return (sceneActive || sceneTicks);
+}
+#endif
+
+// Show a window (live or played back), unless a scene is active
+static void applyWindow(const uint8_t *win)
+{
+    #ifdef FC_HAVE_SCENES
+    if(dmx_get_current_personality(dmxPort) == DMX_PERS_EXT) {
+        if(sceneControl(win))
+            return;
+    }
+    #endif
+
+    setDisplay(win);
+}
+
 /*
 
   0 = ch1:  Master brightness (0-255) (scales down channels 2+3;
@@ -242,45 +873,235 @@ void dmx_loop()
   7 = ch8:  Chase 4 (on/off)                   > ! 0-255; 0-127=off, 128-255=on
   8 = ch9:  Chase 5 (on/off)                   > !
   9 = ch10: Chase 6 (on/off) (inner)           > !
+
+  Extended personality only:
+  
+ 10 = ch11: Center LED strobe rate (0=off; 1=1Hz - 255=25Hz)
+ 11 = ch12: Center LED strobe duty (1-255; 0=50%)
+ 12 = ch13: Box LED strobe rate (0=off; 1=1Hz - 255=25Hz)
+ 13 = ch14: Box LED strobe duty (1-255; 0=50%)
+ 14 = ch15: Chase sync phase (0-255 = one cycle of the chase sequence)
+ 15 = ch16: Sound (0=none; 1-32 = play sound; change value to trigger)
+ 16 = ch17: Sound volume (0-255)
+ 17 = ch18: Procedural chase waveform (replaces auto chase pattern; speed: ch4)
+            (0=off; 1-63=saw; 64-127=sine; 128-191=square; 192-255=random)
+ 18 = ch19: Procedural chase width (0=1 LED - 255=6 LEDs)
+ 19 = ch20: Procedural chase mode (0-63=outward; 64-127=inward;
+            128-191=outward, bounce; 192-255=inward, bounce)
+ 20 = ch21: Special sequence (0=none; 1-9 = play sequence; change value to
+            trigger; shown on top of the look, independent of ch1)
+ 21 = ch22: Scene (0=live; 1-64 = show stored scene instead of ch1-ch21)
+ 22 = ch23: Scene fade time (0-255 = 0-25.5s)
+ 23 = ch24: Store scene (1-64 = store ch1-ch21 as scene; change value to store)
           
 */
 
-static void setDisplay(int base)
+// Strobe rate 1-255 -> period in us (1Hz - 25Hz, linear in Hz)
+static uint32_t strobePeriod(uint8_t rate)
 {
-    int cbri, bbri, mbri;
+    if(!rate) return 0;
+    return 254000000UL / (254 + ((uint32_t)rate - 1) * 24);
+}
 
-    mbri = data[base + 0];
-    
-    if(data[base + 3]) {
-        // Automatic chase
-        if(mbri) {
-            // Speed: 255 = 2; 1 = 20; 0 = off
-            fcLEDs.setSpeed( ((uint16_t)(255 - data[base + 3]) / 14) + 2);
-            fcLEDs.clearCurPattern();
-            fcLEDs.on();
-        } else {
-            fcLEDs.setCurPattern(0);
-            fcLEDs.off();
+static uint32_t strobeOnTime(uint32_t period, uint8_t duty)
+{
+    if(!duty) duty = 128;
+    return (uint32_t)(((uint64_t)period * duty) / 256);
+}
+
+static void setStrobe(PWMLED& led, uint8_t rate, uint8_t duty)
+{
+    uint32_t period = strobePeriod(rate);
+    led.setStrobe(period, strobeOnTime(period, duty));
+}
+
+/*
+ * Chase sync
+ * 
+ * The console sends a phase reference (eg a sawtooth, 0-255 per 
+ * chase cycle) on the sync channel. On every change of this value,
+ * the FC compares it to its own chase phase and adjusts its chase 
+ * speed (PI controller) so that the phase error is corrected 
+ * gradually, without jumps. Between updates, the chase free-runs 
+ * at the corrected speed; after SYNC_TIMEOUT without change, it
+ * returns to nominal speed.
+ */
+static void chaseSync(uint8_t ref)
+{
+    int32_t err, adj;
+
+    if(syncActive && ref == syncLastRef)
+        return;
+
+    syncLastUpdate = millis();
+
+    if(!syncActive) {
+        // First value is only a starting point; sync becomes
+        // active once the value changes
+        if(!syncSeeded || ref == syncLastRef) {
+            syncLastRef = ref;
+            syncSeeded = true;
+            return;
         }
-    } else {
+        syncActive = true;
+    }
+    syncLastRef = ref;
+
+    err = (int16_t)(((uint16_t)ref << 8) - fcLEDs.getPhase());
+
+    syncInteg += err >> SYNC_KI_SHIFT;
+    if(syncInteg > SYNC_MAX_ADJ / 2) syncInteg = SYNC_MAX_ADJ / 2;
+    else if(syncInteg < -SYNC_MAX_ADJ / 2) syncInteg = -SYNC_MAX_ADJ / 2;
+
+    adj = (err >> SYNC_KP_SHIFT) + syncInteg;
+    if(adj > SYNC_MAX_ADJ) adj = SYNC_MAX_ADJ;
+    else if(adj < -SYNC_MAX_ADJ) adj = -SYNC_MAX_ADJ;
+
+    fcLEDs.setRate(256 + adj);
+}
+
+static void chaseSyncOff()
+{
+    syncSeeded = false;
+    if(syncActive) {
+        syncActive = false;
+        syncInteg = 0;
+        fcLEDs.setRate(256);
+    }
+}
+
+static void setDisplay(const uint8_t *win)
+{
+    int cbri, bbri, mbri;
+    uint8_t pat = 0;
+    uint32_t gen = 0;
+    bool isExt = (dmx_get_current_personality(dmxPort) == DMX_PERS_EXT);
+    #ifdef FC_DBG
+    unsigned long spread;
+    #endif
+    #ifdef FC_LATENCY_STATS
+    uint32_t latchCount = fcLEDs.getLatchCount();
+
+    if(latPacketTime) {
+        lat_add(LAT_SETDISPLAY, micros() - latPacketTime);
+    }
+    #endif
+
+    mbri = win[0];
+
+    // Stage all outputs for this frame...
+
+    if(!win[3] && mbri) {
         // manual pattern selection
-        uint8_t pat = 0;
-        if(mbri) {    // master bri
-            for(int i = 0; i < 6; i++) {
-                pat <<= 1;
-                pat |= (data[base + 4 + i] >> 7);   // 0-127=off; 128-255=on
-            }
+        for(int i = 0; i < 6; i++) {
+            pat <<= 1;
+            pat |= (win[4 + i] >> 7);   // 0-127=off; 128-255=on
         }
-        fcLEDs.setCurPattern(pat);
+    }
+
+    if(isExt && win[3] && mbri && win[17]) {
+        // procedural chase
+        // ch20 >> 6: bit 0 = inward, bit 1 = bounce
+        gen = FCGEN_PARAMS(win[17] >> 6, win[18], win[19] >> 6);
     }
 
     cbri = bbri = 0;
     if(mbri) {    // master bri
-        cbri = data[base + 1] * mbri / 255;
-        bbri = data[base + 2] * mbri / 255;
+        cbri = win[1] * mbri / 255;
+        bbri = win[2] * mbri / 255;
     }
+
+    // ...then apply them together: Chase first (forcing
+    // an immediate shift register update instead of
+    // waiting for the next timer tick), PWM right after.
+
+    #ifdef FC_DBG
+    spread = micros();
+    #endif
+    
+    if(win[3] && mbri) {
+        // Automatic chase
+        // Speed: 255 = 2; 1 = 20; 0 = off
+        fcLEDs.setSpeed( ((uint16_t)(255 - win[3]) / 14) + 2);
+        fcLEDs.setGenerator(gen);
+        fcLEDs.clearCurPattern();
+        fcLEDs.on();
+    } else {
+        fcLEDs.setCurPattern(pat);
+        if(win[3]) {
+            fcLEDs.off();
+        }
+    }
+    fcLEDs.commit();
+
+    #ifdef FC_LOOK_RESTORE
+    if(lookFadePending) {
+        // First new look after restoring the last one
+        lookFadePending = false;
+        fadeFromC = centerLED.getDC();
+        fadeFromB = boxLED.getDC();
+        lookFadeStart = millis();
+        lookFading = true;
+    }
+    fadeToC = cbri;
+    fadeToB = bbri;
+    if(lookFading) {
+        lookFade(&cbri, &bbri);
+    }
+    #endif
+    
     centerLED.setDC(cbri);
     boxLED.setDC(bbri);
+
+    #ifdef FC_LATENCY_STATS
+    if(latPacketTime) {
+        lat_add(LAT_PWM, micros() - latPacketTime);
+        if(fcLEDs.getLatchCount() != latchCount) {
+            lat_add(LAT_LATCH, fcLEDs.getLatchTime() - latPacketTime);
+        }
+    }
+    #endif
+
+    #ifdef FC_DBG
+    log_msg(LOG_OUTPUT_SPREAD, micros() - spread);
+    #endif
+
+    if(isExt) {
+        setStrobe(centerLED, win[10], win[11]);
+        setStrobe(boxLED, win[12], win[13]);
+        if(win[3] && mbri) {
+            chaseSync(win[14]);
+        } else {
+            chaseSyncOff();
+        }
+        #ifdef FC_HAVE_AUDIO
+        audio_volume(win[16]);
+        if(win[15] != lastSound) {
+            lastSound = win[15];
+            audio_play(lastSound);
+        }
+        #endif
+        if(win[20] != lastSpecial) {
+            lastSpecial = win[20];
+            fcLEDs.SpecialSignal(lastSpecial <= FCSEQ_MAX ? lastSpecial : 0);
+        }
+    } else {
+        centerLED.setStrobe(0, 0);
+        boxLED.setStrobe(0, 0);
+        chaseSyncOff();
+        if(lastSpecial) {
+            lastSpecial = 0;
+            fcLEDs.SpecialSignal(0);
+        }
+    }
+
+    #ifdef FC_HAVE_SCENES
+    memcpy(dispWin, win, DMX_CHANNELS);
+    #endif
+
+    #ifdef FC_LOOK_RESTORE
+    look_frame(win);
+    #endif
 }
 
 
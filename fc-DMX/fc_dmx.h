@@ -9,12 +9,27 @@
 #ifndef _FC_DMX_H
 #define _FC_DMX_H
 
+#define DMX_CHANNELS_STD 10  // Personality 1: "Standard"
+#define DMX_CHANNELS     24  // Personality 2: "Extended"
+
+#define DMX_PERS_STD  1
+#define DMX_PERS_EXT  2
+#define DMX_PERS_MAX  DMX_PERS_EXT
+
+#define DMX_VERIFY_CHANNEL 46    // must be set to 100 (if verification is on)
+#define DMX_RECORD_CHANNEL 45    // 0-127: don't record; 128-255: record
+
+// Number of channels used in a personality
+#define DMX_FOOTPRINT(p) ((p) == DMX_PERS_EXT ? DMX_CHANNELS : DMX_CHANNELS_STD)
+
 extern unsigned long powerupMillis;
 
 void dmx_boot();
 void dmx_setup();
 void dmx_loop();
 
+bool dmx_addressConflict(int address, int personality, bool verify);
+
 void showWaitSequence();
 void endWaitSequence();
 void showCopyError();
@@ -0,0 +1,57 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_FRAME_H
+#define _FC_FRAME_H
+
+/*
+ * Received DMX frame: Only the slots the FC evaluates, ie the FC's
+ * window, and the start code, verify and record slots.
+ *
+ * Frames are double-buffered: One buffer holds the window currently
+ * shown ("live"), the next packet is read into the other one. If the
+ * new window differs, the buffers are swapped; the live window thereby
+ * doubles as the cache of the last applied frame.
+ */
+
+#include "fc_dmx.h"
+
+#define FRAME_WORDS ((DMX_CHANNELS + 3) / 4)
+
+static_assert(DMX_CHANNELS <= 32, "Changed-slot mask is one word");
+
+typedef struct {
+    union {
+        uint8_t  win[FRAME_WORDS * 4];
+        uint32_t w[FRAME_WORDS];
+    };
+    uint8_t startCode;
+    uint8_t verify;
+    uint8_t record;
+} dmxFrame;
+
+/*
+ * Compare two windows word by word; returns a mask of the changed
+ * slots (bit 0 = channel 1). Bit 7 of each byte of x is set if the
+ * byte is non-zero, the four bits are then gathered into a nibble.
+ * Little endian only (byte 0 = lowest).
+ */
+static inline uint32_t fcframe_diff(const dmxFrame *a, const dmxFrame *b)
+{
+    uint32_t mask = 0;
+
+    for(int i = 0; i < FRAME_WORDS; i++) {
+        uint32_t x = a->w[i] ^ b->w[i];
+        x = (((x & 0x7f7f7f7f) + 0x7f7f7f7f) | x) & 0x80808080;
+        mask |= (((x >> 7) | (x >> 14) | (x >> 21) | (x >> 28)) & 0x0f) << (i * 4);
+    }
+
+    return mask;
+}
+
+#endif
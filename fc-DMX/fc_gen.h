@@ -0,0 +1,103 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_GEN_H
+#define _FC_GEN_H
+
+/*
+ * Procedural chase generator
+ *
+ * Treats the six FC LEDs as a strip (LED 0 = outer) and computes the
+ * pattern for a given chase phase (0-65535 = one cycle):
+ *
+ * - Bounce: phase is folded into a triangle (out and back per cycle)
+ * - Waveform: maps phase to the position of the lit block:
+ *   saw = linear, sine = eased, square = jumps between both ends,
+ *   random = 16 pseudo-random positions per cycle (the same on every
+ *   fixture, so synced fixtures show the same pattern)
+ * - Width: size of the lit block, 1 - 6 LEDs
+ * - Direction: outward or inward
+ *
+ * All waveforms are evaluated and the result is selected, so the cost
+ * per call is the same for all parameters. Positions are 8.8 fixed
+ * point in LED units.
+ *
+ * Parameters are packed into one word, so they can be handed to the
+ * ISR with a single store.
+ */
+
+#define FCGEN_LEDS      6
+#define FCGEN_STEPS     6       // Cycle length in chase steps (as _array)
+
+#define FCGEN_SAW       0
+#define FCGEN_SINE      1
+#define FCGEN_SQUARE    2
+#define FCGEN_RANDOM    3
+
+#define FCGEN_INWARD    0x01
+#define FCGEN_BOUNCE    0x02
+
+#define FCGEN_ON        0x80000000
+
+#define FCGEN_PARAMS(wave, width, flags) \
+    (FCGEN_ON | ((uint32_t)(flags) << 16) | ((uint32_t)(width) << 8) | ((wave) & 3))
+
+// (1 - cos(pi * x)) / 2, 64 segments
+static const DRAM_ATTR uint16_t fcgen_sine[65] = {
+        0,    39,   158,   355,   630,   982,  1411,  1915,
+     2494,  3146,  3869,  4662,  5522,  6448,  7438,  8488,
+     9597, 10762, 11980, 13248, 14563, 15922, 17321, 18758,
+    20228, 21728, 23256, 24806, 26375, 27960, 29556, 31160,
+    32767, 34375, 35979, 37575, 39160, 40729, 42279, 43807,
+    45307, 46777, 48214, 49613, 50972, 52287, 53555, 54773,
+    55938, 57047, 58097, 59087, 60013, 60873, 61666, 62389,
+    63041, 63620, 64124, 64553, 64905, 65180, 65377, 65496,
+    65535
+};
+
+static const DRAM_ATTR uint16_t fcgen_random[16] = {
+    52886, 47175, 48334,  3807, 50564, 39437, 60465, 60124,
+    27542, 60274,  8833, 30864, 39224, 29407, 17346, 64995
+};
+
+static inline __attribute__((always_inline)) uint8_t fcgen_eval(uint32_t params, uint16_t phase)
+{
+    uint32_t p = phase, tri, i, f, u[4], x, w, d;
+    uint32_t flags = (params >> 16) & 0xff;
+    uint8_t  pat = 0;
+
+    tri = ((p ^ (0 - (p >> 15))) << 1) & 0xffff;
+    p = (flags & FCGEN_BOUNCE) ? tri : p;
+
+    i = p >> 10;
+    f = p & 0x3ff;
+    u[FCGEN_SAW]    = p;
+    u[FCGEN_SINE]   = fcgen_sine[i] + ((((int32_t)fcgen_sine[i + 1] - fcgen_sine[i]) * (int32_t)f) >> 10);
+    u[FCGEN_SQUARE] = (p & 0x8000) ? 0xffff : 0;
+    u[FCGEN_RANDOM] = fcgen_random[p >> 12];
+
+    x = (u[params & 3] * (FCGEN_LEDS * 256)) >> 16;
+    x = (flags & FCGEN_INWARD) ? (FCGEN_LEDS * 256 - 1 - x) : x;
+
+    // Width 0-255 -> 1 - 6 LEDs (256 - 1531)
+    w = 256 + ((((params >> 8) & 0xff) * (FCGEN_LEDS - 1) * 256) >> 8);
+
+    for(i = 0; i < FCGEN_LEDS; i++) {
+        int32_t dd = (int32_t)(i * 256 + 128) - (int32_t)x;
+        d = (dd < 0) ? -dd : dd;
+        // Looping: Block wraps around from the last LED to the first
+        if(!(flags & FCGEN_BOUNCE) && d > FCGEN_LEDS * 128) {
+            d = FCGEN_LEDS * 256 - d;
+        }
+        pat = (pat << 1) | (d * 2 <= w);
+    }
+
+    return pat;
+}
+
+#endif
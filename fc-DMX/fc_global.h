@@ -23,6 +23,61 @@
 // be DMX_VERIFY_VALUE for a packet to be accepted.
 //#define DMX_USE_VERIFY
 
+// If this is uncommented, the firmware can record the DMX input to the SD
+// card (while DMX_RECORD_CHANNEL is at 128-255), and plays back this
+// recording when no DMX signal is present. Requires an SD card.
+//#define FC_HAVE_RECORDER
+
+// If this is uncommented, the FC LEDs' shift register is fed by the
+// ESP32's HSPI peripheral instead of bit-banging the GPIOs in the
+// timer interrupt.
+//#define FC_SR_USE_SPI
+
+// If this is uncommented, the firmware plays sounds from the SD card,
+// triggered through DMX (Extended personality only).
+//#define FC_HAVE_AUDIO
+
+// If this is uncommented, the firmware accepts frames through the
+// serial port (see tools/fcinject.py). FC_SERIAL_BAUD optionally 
+// sets a higher baud rate for the serial port.
+//#define FC_HAVE_INJECT
+//#define FC_SERIAL_BAUD 921600
+
+// If this is uncommented, the firmware can act as a DMX monitor (if
+// enabled in the config file), streaming all received DMX data over
+// the serial port (see tools/fcsniff.py).
+//#define FC_HAVE_SNIFFER
+
+// If this is uncommented, the firmware can store up to 64 scenes, 
+// and recall them through DMX (Extended personality only).
+//#define FC_HAVE_SCENES
+
+// If this is uncommented, the firmware stores the current look, and
+// restores it at power-up until DMX data is received.
+//#define FC_LOOK_RESTORE
+
+// If this is uncommented, the firmware stops the FC LED timer and
+// reduces the CPU clock while all outputs are static.
+//#define FC_IDLE_POWERSAVE
+
+// If this is uncommented, the firmware measures the latency from DMX
+// packet reception to the outputs, and prints statistics to Serial.
+// If FC_LATENCY_PIN is defined as well, this pin is pulsed on every
+// shift register latch (for measurements with an oscilloscope).
+// FC_LATENCY_RDM makes the statistics readable through RDM (see
+// fc_latency.cpp).
+//#define FC_LATENCY_STATS
+//#define FC_LATENCY_PIN    IR_FB_PIN
+//#define FC_LATENCY_RDM
+
+// Frame injection and the DMX monitor both send binary data over the
+// serial port, which the host tools can't tell apart. Text output is
+// UTF-8 and never contains their sync byte 0xFC, so it can be mixed
+// with either of them.
+#if defined(FC_HAVE_INJECT) && defined(FC_HAVE_SNIFFER)
+#error "FC_HAVE_INJECT and FC_HAVE_SNIFFER can't be used together"
+#endif
+
 /*************************************************************************
  ***                             GPIO pins                             ***
  *************************************************************************/
@@ -77,4 +132,7 @@
 #define DMX_RECEIVE  13
 #define DMX_ENABLE   32
 
+// DMX monitor: Pin for break/MAB measurement (must see the DMX RX signal)
+#define DMX_SNIFFER_PIN DMX_RECEIVE
+
 #endif
@@ -0,0 +1,40 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_IDLE_H
+#define _FC_IDLE_H
+
+/*
+ * Idle power save: Decision whether idle mode may be entered
+ *
+ * Idle mode is allowed when all outputs are static, no output changed
+ * for more than FC_IDLE_DELAY ms, the recorder neither records nor
+ * plays back, no sound is playing, and no frame was injected through
+ * the serial port for FC_IDLE_DELAY ms.
+ *
+ * Times are millis() values; the differences are taken modulo 2^32,
+ * so the wrap of millis() (after 49.7 days) is harmless.
+ */
+
+#include <stdint.h>
+
+#define FC_IDLE_DELAY   5000
+
+static inline bool fcidle_allowed(uint32_t now, uint32_t lastChange, bool isStatic,
+                                  bool recBusy, bool audBusy, bool injActive, uint32_t lastInjFrame)
+{
+    if(recBusy || audBusy)
+        return false;
+
+    if(injActive && (uint32_t)(now - lastInjFrame) < FC_IDLE_DELAY)
+        return false;
+
+    return ((uint32_t)(now - lastChange) > FC_IDLE_DELAY) && isStatic;
+}
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#ifdef FC_HAVE_INJECT
+
+#include <Arduino.h>
+
+#include "fc_inject.h"
+
+/*
+ * Serial frame injection
+ *
+ * Frames of the FC's slot window can be sent over the serial port
+ * (see tools/fcinject.py):
+ *
+ *   0xFC 0xD3 <seq> <len> <len bytes: ch1..> <crc16 lo> <crc16 hi>
+ *
+ * CRC is CRC-16/CCITT-FALSE over seq, len and data. Each frame is 
+ * acknowledged with
+ *
+ *   0xFC 0xA5 <seq> <status> <latency lo> <latency hi> <timestamp, 4 bytes LE>
+ *
+ * status: 0 = ok, 1 = CRC error, 2 = bad length
+ * latency: us from reception of the last byte to the frame being applied
+ * timestamp: micros() at reception of the last byte
+ *
+ * The port is shared with text output (which never contains 0xFC, see
+ * fc_global.h); the sender must scan for the ack header. The DMX
+ * monitor (FC_HAVE_SNIFFER) can't be built together with this.
+ */
+
+#define INJ_SYNC1       0xfc
+#define INJ_SYNC2       0xd3
+#define INJ_ACK         0xa5
+#define INJ_MAXLEN      64
+#define INJ_MAX_BYTES   64      // max bytes processed per loop
+
+#define INJ_OK          0
+#define INJ_ERR_CRC     1
+#define INJ_ERR_LEN     2
+
+enum {
+    INJ_S_SYNC1 = 0,
+    INJ_S_SYNC2,
+    INJ_S_SEQ,
+    INJ_S_LEN,
+    INJ_S_DATA,
+    INJ_S_CRC1,
+    INJ_S_CRC2
+};
+
+static uint8_t  injState = INJ_S_SYNC1;
+static uint8_t  injSeq;
+static uint8_t  injLen;
+static uint8_t  injPos;
+static uint8_t  injBuf[INJ_MAXLEN];
+static uint16_t injCRC;
+static uint16_t injRxCRC;
+static uint32_t injRxTime;
+
+static uint16_t crc16(uint16_t crc, uint8_t b)
+{
+    crc ^= (uint16_t)b << 8;
+    for(int i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+static void sendAck(uint8_t seq, uint8_t status)
+{
+    uint32_t lat = micros() - injRxTime;
+    uint8_t  ack[10];
+
+    if(lat > 0xffff) lat = 0xffff;
+
+    ack[0] = INJ_SYNC1;
+    ack[1] = INJ_ACK;
+    ack[2] = seq;
+    ack[3] = status;
+    ack[4] = lat & 0xff;
+    ack[5] = lat >> 8;
+    ack[6] = injRxTime & 0xff;
+    ack[7] = (injRxTime >> 8) & 0xff;
+    ack[8] = (injRxTime >> 16) & 0xff;
+    ack[9] = injRxTime >> 24;
+
+    Serial.write(ack, sizeof(ack));
+}
+
+/*
+ * Parse incoming bytes; returns the frame length if a
+ * valid frame was received and copied to frame, else 0.
+ * Caller must then call inject_ack() after applying
+ * the frame.
+ */
+int inject_loop(uint8_t *frame, int maxLen)
+{
+    int count = INJ_MAX_BYTES;
+    int c;
+
+    while(count-- && (c = Serial.read()) >= 0) {
+
+        switch(injState) {
+        case INJ_S_SYNC1:
+            if(c == INJ_SYNC1) injState = INJ_S_SYNC2;
+            break;
+        case INJ_S_SYNC2:
+            injState = (c == INJ_SYNC2) ? INJ_S_SEQ : ((c == INJ_SYNC1) ? INJ_S_SYNC2 : INJ_S_SYNC1);
+            break;
+        case INJ_S_SEQ:
+            injSeq = c;
+            injCRC = crc16(0xffff, c);
+            injState = INJ_S_LEN;
+            break;
+        case INJ_S_LEN:
+            injLen = c;
+            injPos = 0;
+            injCRC = crc16(injCRC, c);
+            if(!injLen || injLen > INJ_MAXLEN) {
+                injRxTime = micros();
+                sendAck(injSeq, INJ_ERR_LEN);
+                injState = INJ_S_SYNC1;
+            } else {
+                injState = INJ_S_DATA;
+            }
+            break;
+        case INJ_S_DATA:
+            injBuf[injPos++] = c;
+            injCRC = crc16(injCRC, c);
+            if(injPos == injLen) injState = INJ_S_CRC1;
+            break;
+        case INJ_S_CRC1:
+            injRxCRC = c;
+            injState = INJ_S_CRC2;
+            break;
+        case INJ_S_CRC2:
+            injRxCRC |= (uint16_t)c << 8;
+            injRxTime = micros();
+            injState = INJ_S_SYNC1;
+            if(injRxCRC != injCRC) {
+                sendAck(injSeq, INJ_ERR_CRC);
+            } else if(injLen > maxLen) {
+                sendAck(injSeq, INJ_ERR_LEN);
+            } else {
+                memcpy(frame, injBuf, injLen);
+                return injLen;
+            }
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void inject_ack()
+{
+    sendAck(injSeq, INJ_OK);
+}
+
+#endif  // FC_HAVE_INJECT
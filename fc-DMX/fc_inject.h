@@ -0,0 +1,19 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_INJECT_H
+#define _FC_INJECT_H
+
+#ifdef FC_HAVE_INJECT
+
+int  inject_loop(uint8_t *frame, int maxLen);
+void inject_ack();
+
+#endif
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#ifdef FC_LATENCY_STATS
+
+#include <Arduino.h>
+#include <esp_dmx.h>
+
+#include "fc_latency.h"
+#include "fc_log.h"
+
+/*
+ * DMX-to-light latency statistics
+ *
+ * Per stage, a histogram with power-of-two buckets (bucket n counts
+ * latencies of 2^(n-1) to 2^n - 1 us; bucket 0 counts 0us) plus
+ * min/max/average. Every LAT_REPORT_MS, if there are new samples, a
+ * snapshot is taken and handed to the logger task, which prints it
+ * (the loop never waits for Serial).
+ *
+ * With FC_LATENCY_RDM, the snapshot can also be read through RDM, as
+ * manufacturer-specific parameter LAT_RDM_PID (GET only). Parameter
+ * data (big endian, as usual in RDM): Per stage count, min, avg and
+ * max in us (4 bytes each), then per stage the LAT_BUCKETS histogram
+ * counts (2 bytes each, saturating at 65535).
+ */
+
+#define LAT_BUCKETS     20          // last bucket: >= 2^18us (262ms)
+#define LAT_REPORT_MS   10000
+
+#define LAT_RDM_PID     0x8001
+#define LAT_RDM_SIZE    (LAT_STAGES * (16 + 2 * LAT_BUCKETS))
+#define LAT_RDM_W20     "wwwwwwwwwwwwwwwwwwww"
+#define LAT_RDM_FMT     "dddddddddddd" LAT_RDM_W20 LAT_RDM_W20 LAT_RDM_W20 "$"
+static_assert(LAT_STAGES == 3 && LAT_BUCKETS == 20, "LAT_RDM_FMT must be adapted");
+
+static const char *latNames[LAT_STAGES] = {
+    "setDisplay",
+    "PWM",
+    "Latch"
+};
+
+typedef struct {
+    uint32_t hist[LAT_STAGES][LAT_BUCKETS];
+    uint32_t count[LAT_STAGES];
+    uint32_t min[LAT_STAGES];
+    uint32_t max[LAT_STAGES];
+    uint64_t sum[LAT_STAGES];
+} latStats_t;
+
+static latStats_t lat;
+static latStats_t latSnap;                  // being printed by the logger task
+
+static bool          latNew = false;
+static volatile bool latPrinting = false;
+static uint32_t      latReports = 0;
+static unsigned long latLastReport = 0;
+
+#ifdef FC_LATENCY_RDM
+static dmx_port_t latPort;
+static uint8_t    latRDM[LAT_RDM_SIZE];
+static rdm_pd_definition_t latPD;
+
+static uint8_t *put_be(uint8_t *p, uint32_t val, int len)
+{
+    while(len--) {
+        *p++ = val >> (len * 8);
+    }
+    return p;
+}
+
+static void lat_rdm_update()
+{
+    uint8_t *p = latRDM;
+
+    for(int i = 0; i < LAT_STAGES; i++) {
+        p = put_be(p, latSnap.count[i], 4);
+        p = put_be(p, latSnap.min[i], 4);
+        p = put_be(p, latSnap.count[i] ? (uint32_t)(latSnap.sum[i] / latSnap.count[i]) : 0, 4);
+        p = put_be(p, latSnap.max[i], 4);
+    }
+    for(int i = 0; i < LAT_STAGES; i++) {
+        for(int j = 0; j < LAT_BUCKETS; j++) {
+            p = put_be(p, latSnap.hist[i][j] > 0xffff ? 0xffff : latSnap.hist[i][j], 2);
+        }
+    }
+
+    rdm_set_parameter(latPort, RDM_SUB_DEVICE_ROOT, LAT_RDM_PID, latRDM, sizeof(latRDM));
+}
+#endif
+
+/*
+ * Register the RDM parameter (FC_LATENCY_RDM only); call after
+ * installing the DMX driver
+ */
+void lat_setup(dmx_port_t port)
+{
+    #ifdef FC_LATENCY_RDM
+    latPD.pid = LAT_RDM_PID;
+    latPD.schema.data_type = RDM_DS_NOT_DEFINED;
+    latPD.schema.cc = RDM_CC_GET;
+    latPD.schema.alloc_size = LAT_RDM_SIZE;
+    latPD.schema.format = LAT_RDM_FMT;
+    latPD.nvs = false;
+    latPD.response_handler = rdm_simple_response_handler;
+
+    latPort = port;
+    if(!rdm_register_parameter(port, RDM_SUB_DEVICE_ROOT, &latPD, latRDM, NULL, NULL)) {
+        Serial.println("Latency: Failed to register RDM parameter");
+    }
+    #endif
+}
+
+void lat_add(int stage, uint32_t us)
+{
+    int b = us ? 32 - __builtin_clz(us) : 0;
+
+    if(b >= LAT_BUCKETS) b = LAT_BUCKETS - 1;
+
+    lat.hist[stage][b]++;
+    if(!lat.count[stage] || us < lat.min[stage]) lat.min[stage] = us;
+    if(us > lat.max[stage]) lat.max[stage] = us;
+    lat.sum[stage] += us;
+    lat.count[stage]++;
+
+    latNew = true;
+}
+
+void lat_loop()
+{
+    if(!latNew || latPrinting || (millis() - latLastReport < LAT_REPORT_MS))
+        return;
+
+    latSnap = lat;
+    latNew = false;
+    latLastReport = millis();
+
+    #ifdef FC_LATENCY_RDM
+    lat_rdm_update();
+    #endif
+
+    latPrinting = true;
+    if(!log_msg(LOG_LATENCY, ++latReports)) {
+        latPrinting = false;
+    }
+}
+
+// Called by the logger task
+void lat_print()
+{
+    for(int i = 0; i < LAT_STAGES; i++) {
+        if(!latSnap.count[i])
+            continue;
+        Serial.printf("Latency %s: n=%lu min=%luus avg=%luus max=%luus\n", latNames[i],
+              (unsigned long)latSnap.count[i], (unsigned long)latSnap.min[i], 
+              (unsigned long)(latSnap.sum[i] / latSnap.count[i]), (unsigned long)latSnap.max[i]);
+        for(int j = 0; j < LAT_BUCKETS; j++) {
+            if(latSnap.hist[i][j]) {
+                Serial.printf("  <%luus: %lu\n", 1UL << j, (unsigned long)latSnap.hist[i][j]);
+            }
+        }
+    }
+
+    latPrinting = false;
+}
+
+#endif  // FC_LATENCY_STATS
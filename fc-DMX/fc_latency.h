@@ -0,0 +1,27 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_LATENCY_H
+#define _FC_LATENCY_H
+
+#ifdef FC_LATENCY_STATS
+
+// Stages, each measured from packet reception
+#define LAT_SETDISPLAY  0     // setDisplay() called
+#define LAT_PWM         1     // Center/Box PWM written
+#define LAT_LATCH       2     // Shift register latched
+#define LAT_STAGES      3
+
+void lat_setup(dmx_port_t port);
+void lat_add(int stage, uint32_t us);
+void lat_loop();
+void lat_print();
+
+#endif
+
+#endif
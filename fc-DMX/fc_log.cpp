@@ -0,0 +1,180 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#include <Arduino.h>
+#ifdef FC_LATENCY_STATS
+#include <esp_dmx.h>
+#endif
+
+#include "fc_log.h"
+#include "fc_latency.h"
+
+/*
+ * Non-blocking logger
+ *
+ * Serial output at 115200 baud takes roughly 87us per character, and
+ * Serial.printf() blocks once the UART's TX buffer is full. Callers on
+ * the DMX receive path therefore only store a small binary record in a
+ * lock-free ring buffer (single producer: the loop task; single consumer:
+ * the logger task). The logger task formats the records and prints them.
+ *
+ * Identical consecutive messages are collapsed into a "repeated N times"
+ * line; records that don't fit into the buffer are counted and reported.
+ *
+ * Longer reports (latency statistics) are queued as a record as well;
+ * the logger task then calls the report's print function.
+ */
+
+#define LOG_RB_SIZE   64        // must be power of 2
+#define LOG_POLL_MS   20
+#define LOG_REPEAT_MS 1000      // Max time to hold back a repeat count
+
+typedef struct {
+    uint8_t id;
+    int32_t arg;
+} logRec_t;
+
+static const char *logFmt[LOG_MAX + 1] = {
+    "DMX is connected\n",                       // LOG_DMX_CONNECTED
+    "DMX was disconnected\n",                   // LOG_DMX_DISCONNECTED
+    "DMX error: %d\n",                          // LOG_DMX_ERROR
+    "Unrecognized start code %d (0x%02x)\n",    // LOG_DMX_STARTCODE
+    "Recorder: Recording started\n",            // LOG_REC_STARTED
+    "Player: Playback started\n",               // LOG_PLAY_STARTED
+    "Player: Playback stopped\n",               // LOG_PLAY_STOPPED
+    "Player: Bad recording\n",                  // LOG_PLAY_BAD
+    "Scenes: Scene %d stored\n",                // LOG_SCENE_STORED
+    "Scenes: Scene %d could not be stored\n",   // LOG_SCENE_FAILED
+    "setDisplay: Outputs applied within %d us\n",   // LOG_OUTPUT_SPREAD
+    "fcdisplay: Setting speed %d\n",            // LOG_FC_SPEED
+    "Entering idle mode\n",                     // LOG_IDLE_ENTER
+    "Leaving idle mode, took %d us\n",          // LOG_IDLE_LEAVE
+    NULL                                        // LOG_LATENCY
+};
+
+static logRec_t          logRB[LOG_RB_SIZE];
+static volatile uint32_t logHead = 0;
+static volatile uint32_t logTail = 0;
+static volatile uint32_t logDropped = 0;
+static volatile unsigned long logMaxTime = 0;
+
+static TaskHandle_t logTask = NULL;
+
+static void logTaskFunc(void *parm);
+
+void log_setup()
+{
+    xTaskCreatePinnedToCore(logTaskFunc, "logger", 2048, NULL, 1, &logTask, 0);
+}
+
+static void log_print(uint8_t id, int32_t arg)
+{
+    #ifdef FC_LATENCY_STATS
+    if(id == LOG_LATENCY) {
+        lat_print();
+        return;
+    }
+    #endif
+    if(logFmt[id]) {
+        Serial.printf(logFmt[id], arg, arg);
+    }
+}
+
+/*
+ * Queue a message. Never blocks. If the logger task isn't running
+ * (yet), messages are printed directly. Returns false if the message
+ * was dropped.
+ */
+bool log_msg(uint8_t id, int32_t arg)
+{
+    uint32_t head = logHead;
+    #ifdef FC_DBG
+    unsigned long now = micros();
+    #endif
+
+    if(!logTask) {
+        log_print(id, arg);
+        return true;
+    }
+
+    if(head - __atomic_load_n(&logTail, __ATOMIC_ACQUIRE) >= LOG_RB_SIZE) {
+        logDropped++;
+        return false;
+    }
+
+    logRB[head & (LOG_RB_SIZE - 1)].id = id;
+    logRB[head & (LOG_RB_SIZE - 1)].arg = arg;
+    __atomic_store_n(&logHead, head + 1, __ATOMIC_RELEASE);
+
+    #ifdef FC_DBG
+    now = micros() - now;
+    if(now > logMaxTime) logMaxTime = now;
+    #endif
+
+    return true;
+}
+
+static void logTaskFunc(void *parm)
+{
+    uint32_t tail = 0, dropped = 0, newDropped;
+    uint32_t repeats = 0;
+    unsigned long lastPrint = 0;
+    #ifdef FC_DBG
+    unsigned long maxTime = 0, newMaxTime;
+    #endif
+    logRec_t last = { 0xff, 0 };
+
+    for(;;) {
+
+        vTaskDelay(pdMS_TO_TICKS(LOG_POLL_MS));
+
+        while(tail != __atomic_load_n(&logHead, __ATOMIC_ACQUIRE)) {
+
+            logRec_t rec = logRB[tail & (LOG_RB_SIZE - 1)];
+            __atomic_store_n(&logTail, ++tail, __ATOMIC_RELEASE);
+
+            if(rec.id == last.id && rec.arg == last.arg) {
+                repeats++;
+                continue;
+            }
+
+            if(repeats) {
+                Serial.printf("(last message repeated %lu times)\n", (unsigned long)repeats);
+                repeats = 0;
+            }
+
+            if(rec.id <= LOG_MAX) {
+                log_print(rec.id, rec.arg);
+            }
+            last = rec;
+            lastPrint = millis();
+        }
+
+        if(repeats && (millis() - lastPrint > LOG_REPEAT_MS)) {
+            Serial.printf("(last message repeated %lu times)\n", (unsigned long)repeats);
+            repeats = 0;
+            lastPrint = millis();
+            // Print the next occurrence again
+            last.id = 0xff;
+        }
+
+        if((newDropped = logDropped) != dropped) {
+            Serial.printf("Logger: %lu messages dropped\n", (unsigned long)(newDropped - dropped));
+            dropped = newDropped;
+        }
+
+        #ifdef FC_DBG
+        if((newMaxTime = logMaxTime) != maxTime) {
+            Serial.printf("Logger: Max time in log_msg() %lu us\n", newMaxTime);
+            maxTime = newMaxTime;
+        }
+        #endif
+    }
+}
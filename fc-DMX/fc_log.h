@@ -0,0 +1,33 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_LOG_H
+#define _FC_LOG_H
+
+// Message ids; see logFmt[] in fc_log.cpp
+#define LOG_DMX_CONNECTED     0
+#define LOG_DMX_DISCONNECTED  1
+#define LOG_DMX_ERROR         2
+#define LOG_DMX_STARTCODE     3
+#define LOG_REC_STARTED       4
+#define LOG_PLAY_STARTED      5
+#define LOG_PLAY_STOPPED      6
+#define LOG_PLAY_BAD          7
+#define LOG_SCENE_STORED      8
+#define LOG_SCENE_FAILED      9
+#define LOG_OUTPUT_SPREAD     10    // FC_DBG
+#define LOG_FC_SPEED          11    // FC_DBG
+#define LOG_IDLE_ENTER        12    // FC_DBG
+#define LOG_IDLE_LEAVE        13    // FC_DBG
+#define LOG_LATENCY           14    // lat_print() (FC_LATENCY_STATS)
+#define LOG_MAX               LOG_LATENCY
+
+void log_setup();
+bool log_msg(uint8_t id, int32_t arg = 0);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#ifdef FC_LOOK_RESTORE
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <stddef.h>
+
+#include "fc_look.h"
+#include "fc_dmx.h"
+
+/*
+ * Look persistence
+ *
+ * The last applied channel window and the chase phase are kept in
+ * RTC memory (survives resets, eg. watchdog or brownout) and in NVS
+ * (survives power cycles). At boot, the RTC copy is used if valid,
+ * the NVS copy otherwise.
+ *
+ * The RTC copy is updated on every change. NVS is only written once
+ * the look has been unchanged for LOOK_STABLE_MS, and no more often
+ * than every LOOK_NVS_MIN_MS, to limit flash wear. A running chase
+ * does not count as a change; its phase is stored along with the
+ * look, but not compared.
+ *
+ * Writing NVS can take tens of milliseconds (longer if flash pages
+ * need to be erased), so the loop only hands the look over to a
+ * low-priority task, which writes it.
+ */
+
+#define LOOK_NVS_NS      "fcdmx"
+#define LOOK_NVS_KEY     "look"
+#define LOOK_VERSION     1
+#define LOOK_MAGIC       0x46434c4b     // "FCLK"
+
+#define LOOK_STABLE_MS   10000
+#define LOOK_NVS_MIN_MS  60000
+#define LOOK_PHASE_MS    100            // RTC phase update interval
+
+struct lookData {
+    uint16_t version;
+    uint16_t size;
+    uint16_t phase;
+    uint8_t  window[DMX_CHANNELS];
+};
+
+// Hashed part (excludes trailing padding)
+#define LOOK_DATA_LEN    (offsetof(struct lookData, window) + DMX_CHANNELS)
+
+struct lookRTC {
+    uint32_t magic;
+    struct lookData d;
+    uint32_t hash;
+};
+
+static RTC_NOINIT_ATTR struct lookRTC rtcLook;
+
+static struct lookData nvsLook;
+static bool            haveNVSLook = false;
+static bool            lookDirty = false;
+static unsigned long   lastLookChange = 0;
+static unsigned long   lastNVSWrite = 0;
+static unsigned long   lastPhaseUpdate = 0;
+
+static TaskHandle_t    lookTask = NULL;
+static volatile bool   lookSaving = false;  // nvsLook, haveNVSLook, lastNVSWrite owned by task
+
+static void lookTaskFunc(void *parm);
+
+// FNV-1a
+static uint32_t look_hash(const struct lookData *d)
+{
+    const uint8_t *p = (const uint8_t *)d;
+    uint32_t hash = 2166136261UL;
+
+    for(int i = 0; i < (int)LOOK_DATA_LEN; i++) {
+        hash ^= p[i];
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+static bool look_valid(const struct lookData *d)
+{
+    return (d->version == LOOK_VERSION && d->size == DMX_CHANNELS);
+}
+
+static void look_updRTC()
+{
+    rtcLook.hash = look_hash(&rtcLook.d);
+    rtcLook.magic = LOOK_MAGIC;
+}
+
+/*
+ * Load the last look. Returns false if there is none.
+ * Called very early at boot, so this must be quick.
+ */
+bool look_load(uint8_t *window, uint16_t *phase)
+{
+    Preferences prefs;
+
+    if(prefs.begin(LOOK_NVS_NS, true)) {
+        if((prefs.getBytesLength(LOOK_NVS_KEY) == sizeof(nvsLook)) &&
+           (prefs.getBytes(LOOK_NVS_KEY, &nvsLook, sizeof(nvsLook)) == sizeof(nvsLook))) {
+            haveNVSLook = look_valid(&nvsLook);
+        }
+        prefs.end();
+    }
+
+    if(rtcLook.magic != LOOK_MAGIC || !look_valid(&rtcLook.d) ||
+       rtcLook.hash != look_hash(&rtcLook.d)) {
+        if(!haveNVSLook) {
+            rtcLook.magic = 0;
+            return false;
+        }
+        rtcLook.d = nvsLook;
+        look_updRTC();
+    }
+
+    memcpy(window, rtcLook.d.window, DMX_CHANNELS);
+    *phase = rtcLook.d.phase;
+
+    return true;
+}
+
+void look_setup()
+{
+    xTaskCreatePinnedToCore(lookTaskFunc, "lookSave", 2048, NULL, 0, &lookTask, 0);
+}
+
+static void look_save()
+{
+    Preferences prefs;
+    #ifdef FC_DBG
+    unsigned long now = millis();
+    #endif
+
+    if(prefs.begin(LOOK_NVS_NS, false)) {
+        haveNVSLook = (prefs.putBytes(LOOK_NVS_KEY, &nvsLook, sizeof(nvsLook)) == sizeof(nvsLook));
+        prefs.end();
+        lastNVSWrite = millis();
+        #ifdef FC_DBG
+        Serial.printf("Look: Saved to NVS, took %lu ms\n", lastNVSWrite - now);
+        #endif
+    }
+}
+
+static void lookTaskFunc(void *parm)
+{
+    (void)parm;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        look_save();
+        __atomic_store_n(&lookSaving, false, __ATOMIC_RELEASE);
+    }
+}
+
+// Call with the channel window after it was applied
+void look_frame(const uint8_t *window)
+{
+    if(rtcLook.magic == LOOK_MAGIC && !memcmp(rtcLook.d.window, window, DMX_CHANNELS))
+        return;
+
+    rtcLook.d.version = LOOK_VERSION;
+    rtcLook.d.size = DMX_CHANNELS;
+    memcpy(rtcLook.d.window, window, DMX_CHANNELS);
+    look_updRTC();
+
+    lookDirty = true;
+    lastLookChange = millis();
+}
+
+/*
+ * getPhase is only called when the phase is due for an update (it
+ * holds off the FC LED ISR for a moment).
+ */
+void look_loop(uint16_t (*getPhase)())
+{
+    unsigned long now = millis();
+
+    if(rtcLook.magic != LOOK_MAGIC)
+        return;
+
+    if(now - lastPhaseUpdate >= LOOK_PHASE_MS) {
+        rtcLook.d.phase = getPhase();
+        look_updRTC();
+        lastPhaseUpdate = now;
+    }
+
+    if(!lookDirty || (now - lastLookChange < LOOK_STABLE_MS))
+        return;
+
+    if(__atomic_load_n(&lookSaving, __ATOMIC_ACQUIRE))
+        return;
+
+    if(lastNVSWrite && (now - lastNVSWrite < LOOK_NVS_MIN_MS))
+        return;
+
+    lookDirty = false;
+
+    if(haveNVSLook && !memcmp(nvsLook.window, rtcLook.d.window, DMX_CHANNELS))
+        return;
+
+    nvsLook = rtcLook.d;
+
+    if(!lookTask) {
+        look_save();
+        return;
+    }
+
+    lookSaving = true;
+    xTaskNotifyGive(lookTask);
+}
+
+#endif  // FC_LOOK_RESTORE
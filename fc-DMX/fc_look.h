@@ -0,0 +1,21 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_LOOK_H
+#define _FC_LOOK_H
+
+#ifdef FC_LOOK_RESTORE
+
+bool look_load(uint8_t *window, uint16_t *phase);
+void look_setup();
+void look_frame(const uint8_t *window);
+void look_loop(uint16_t (*getPhase)());
+
+#endif
+
+#endif
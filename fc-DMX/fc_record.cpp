@@ -0,0 +1,606 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#ifdef FC_HAVE_RECORDER
+
+#include <Arduino.h>
+#include <SD.h>
+#include <FS.h>
+
+#include "fc_record.h"
+#include "fc_settings.h"
+#include "fc_log.h"
+
+/*
+ * DMX recorder & player
+ *
+ * Recording format (file on SD):
+ *
+ * Header: 'F' 'C' 'R' <version> <number of channels>
+ *
+ * Then a stream of records, one per changed frame:
+ *  - Time since previous record in ms (LEB128 varint)
+ *  - Bitmask of changed channels ((numChannels + 7) / 8 bytes, LSB = ch1)
+ *  - One byte per set bit in the mask, the new channel value
+ *
+ * Unchanged channels cost one bit, unchanged frames cost nothing. The
+ * first record (and the first one after a buffer overrun) is a keyframe
+ * with all bits set. The last record has an empty mask and only carries
+ * the time until recording was stopped, so loops keep their full length.
+ *
+ * Recording: dmx_loop() only encodes a record into a RAM ring buffer;
+ * a low-priority task drains that buffer to the SD card. If the SD
+ * card can't keep up, records are dropped (and counted) instead of
+ * blocking reception.
+ *
+ * Playback: The same task reads the recording ahead into a second
+ * ring buffer, from which dmx_loop() decodes the records; the loop
+ * never waits for the SD card. Opening, rewinding and closing the
+ * file are requests to the task; the loop doesn't touch the buffer
+ * until the task has carried out the latest request.
+ */
+
+#define REC_FILENAME     "/fcshow.rec"
+#define REC_TMPNAME      "/fcshow.tmp"
+#define REC_VERSION      1
+#define REC_HDR_SIZE     5
+
+#define REC_MAX_CHANNELS 32
+#define REC_MAX_MASK     ((REC_MAX_CHANNELS + 7) / 8)
+#define REC_MAX_RECLEN   (5 + REC_MAX_MASK + REC_MAX_CHANNELS)
+
+#define REC_RB_SIZE      4096     // must be power of 2
+#define REC_CHUNK_SIZE   512
+#define REC_FLUSH_MS     250
+
+#define PLAY_RB_SIZE     2048     // must be power of 2
+#define PLAY_CHUNK_SIZE  512
+
+#define PLAY_REQ_OPEN    0
+#define PLAY_REQ_REWIND  1
+#define PLAY_REQ_CLOSE   2
+
+static int numChans = 0;
+static int maskLen = 0;
+
+// Ring buffer: Written by loop(), read by writer task
+static uint8_t           recRB[REC_RB_SIZE];
+static volatile uint32_t recHead = 0;
+static volatile uint32_t recTail = 0;
+
+static TaskHandle_t      recTask = NULL;
+static volatile bool     recActive = false;
+static volatile bool     recOpenReq = false;
+static volatile bool     recCloseReq = false;
+static File              recFile;
+
+static uint8_t           recLastFrame[REC_MAX_CHANNELS];
+static bool              recNeedKey = false;
+static unsigned long     recLastTime;
+static unsigned long     recStartTime;
+
+// Statistics
+static volatile uint32_t recBytes = 0;
+static volatile uint32_t recDuration = 0;
+static uint32_t          recDropped = 0;
+static unsigned long     recMaxPush = 0;
+static volatile unsigned long recMaxWrite = 0;
+
+// Player; ring buffer written by task, read by loop()
+static uint8_t           playRB[PLAY_RB_SIZE];
+static volatile uint32_t playHead = 0;
+static volatile uint32_t playTail = 0;
+static volatile bool     playEOF = false;
+static volatile bool     playErr = false;
+static volatile uint8_t  playReq = PLAY_REQ_CLOSE;
+static volatile uint32_t playGen = 0;
+static volatile uint32_t playDoneGen = 0;
+static File              playFile;              // task only
+
+static volatile bool     playAvail = false;
+static bool              playing = false;
+static bool              playHdrDone = false;
+static bool              playRestart = false;
+static bool              playHavePending = false;
+static uint8_t           playMask[REC_MAX_MASK];
+static uint8_t           playVals[REC_MAX_CHANNELS];
+static unsigned long     playBase;
+static unsigned long     playNextTime;
+
+static void recTaskFunc(void *parm);
+
+void rec_setup(int numChannels)
+{
+    if(numChannels > REC_MAX_CHANNELS) {
+        Serial.println("Recorder: Too many channels");
+        return;
+    }
+
+    numChans = numChannels;
+    maskLen = (numChannels + 7) / 8;
+
+    if(!haveSD) {
+        Serial.println("Recorder: No SD card, recorder disabled");
+        return;
+    }
+
+    playAvail = SD.exists(REC_FILENAME);
+
+    xTaskCreatePinnedToCore(recTaskFunc, "recorder", 4096, NULL, 1, &recTask, 0);
+}
+
+/*
+ * Recorder
+ */
+
+static uint32_t rb_free()
+{
+    return REC_RB_SIZE - (recHead - recTail);
+}
+
+static bool rb_put(const uint8_t *buf, int len)
+{
+    uint32_t head = recHead;
+
+    if(rb_free() < (uint32_t)len)
+        return false;
+
+    for(int i = 0; i < len; i++) {
+        recRB[(head + i) & (REC_RB_SIZE - 1)] = buf[i];
+    }
+    __atomic_store_n(&recHead, head + len, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static void rec_encode(const uint8_t *frame, bool isEnd)
+{
+    uint8_t  rec[REC_MAX_RECLEN];
+    int      len = 0, mpos;
+    uint32_t delta;
+    unsigned long now = millis();
+    bool     haveChange = false;
+
+    delta = now - recLastTime;
+    do {
+        rec[len] = delta & 0x7f;
+        delta >>= 7;
+        if(delta) rec[len] |= 0x80;
+        len++;
+    } while(delta);
+
+    mpos = len;
+    memset(rec + mpos, 0, maskLen);
+    len += maskLen;
+
+    if(!isEnd) {
+        for(int i = 0; i < numChans; i++) {
+            if(recNeedKey || frame[i] != recLastFrame[i]) {
+                rec[mpos + (i >> 3)] |= (1 << (i & 7));
+                rec[len++] = frame[i];
+                haveChange = true;
+            }
+        }
+        if(!haveChange)
+            return;
+    }
+
+    if(rb_put(rec, len)) {
+        if(!isEnd) {
+            memcpy(recLastFrame, frame, numChans);
+            recNeedKey = false;
+        }
+        recLastTime = now;
+    } else {
+        recDropped++;
+        recNeedKey = true;
+    }
+}
+
+void rec_start(const uint8_t *frame)
+{
+    if(!recTask || recActive || recCloseReq)
+        return;
+
+    recHead = recTail = 0;
+    recBytes = 0;
+    recDropped = 0;
+    recMaxPush = recMaxWrite = 0;
+    recNeedKey = true;
+    recStartTime = recLastTime = millis();
+
+    recOpenReq = true;
+    recActive = true;
+
+    rec_encode(frame, false);
+
+    log_msg(LOG_REC_STARTED);
+
+    xTaskNotifyGive(recTask);
+}
+
+void rec_stop()
+{
+    if(!recActive)
+        return;
+
+    rec_encode(NULL, true);
+    recDuration = millis() - recStartTime;
+
+    recActive = false;
+    recCloseReq = true;
+
+    xTaskNotifyGive(recTask);
+}
+
+bool rec_isRecording()
+{
+    return recActive;
+}
+
+void rec_frame(const uint8_t *frame)
+{
+    unsigned long start;
+
+    if(!recActive)
+        return;
+
+    start = micros();
+
+    rec_encode(frame, false);
+
+    if(REC_RB_SIZE - rb_free() >= REC_CHUNK_SIZE) {
+        xTaskNotifyGive(recTask);
+    }
+
+    start = micros() - start;
+    if(start > recMaxPush) recMaxPush = start;
+}
+
+static void rec_drain()
+{
+    uint32_t tail = recTail;
+    uint32_t head = __atomic_load_n(&recHead, __ATOMIC_ACQUIRE);
+
+    while(head != tail) {
+        uint32_t toff = tail & (REC_RB_SIZE - 1);
+        uint32_t len = head - tail;
+        unsigned long start;
+
+        if(len > REC_RB_SIZE - toff) len = REC_RB_SIZE - toff;
+        if(len > REC_CHUNK_SIZE) len = REC_CHUNK_SIZE;
+
+        start = micros();
+        if(recFile) {
+            sd_lock();
+            recFile.write(recRB + toff, len);
+            sd_unlock();
+        }
+        start = micros() - start;
+        if(start > recMaxWrite) recMaxWrite = start;
+
+        tail += len;
+        recBytes += len;
+        __atomic_store_n(&recTail, tail, __ATOMIC_RELEASE);
+
+        head = __atomic_load_n(&recHead, __ATOMIC_ACQUIRE);
+    }
+}
+
+static void play_serve();
+
+static void recTaskFunc(void *parm)
+{
+    (void)parm;
+
+    for(;;) {
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(REC_FLUSH_MS));
+
+        if(recOpenReq) {
+            uint8_t hdr[REC_HDR_SIZE] = { 'F', 'C', 'R', REC_VERSION, (uint8_t)numChans };
+            sd_lock();
+            SD.remove(REC_TMPNAME);
+            if((recFile = SD.open(REC_TMPNAME, FILE_WRITE))) {
+                recFile.write(hdr, REC_HDR_SIZE);
+            }
+            sd_unlock();
+            if(!recFile) {
+                Serial.println("Recorder: Failed to create file");
+            }
+            recOpenReq = false;
+        }
+
+        rec_drain();
+
+        if(recCloseReq) {
+            if(recFile) {
+                uint32_t bpm = recDuration ? (uint32_t)((uint64_t)recBytes * 60000 / recDuration) : 0;
+                sd_lock();
+                recFile.close();
+                SD.remove(REC_FILENAME);
+                SD.rename(REC_TMPNAME, REC_FILENAME);
+                sd_unlock();
+                playAvail = true;
+                Serial.printf("Recorder: Recorded %lu bytes in %lu ms (%lu bytes/min), %lu records dropped\n",
+                          (unsigned long)recBytes, (unsigned long)recDuration, (unsigned long)bpm, 
+                          (unsigned long)recDropped);
+                Serial.printf("Recorder: Max encode time %lu us, max SD write time %lu us\n",
+                          recMaxPush, recMaxWrite);
+            }
+            recCloseReq = false;
+        } else if(recFile) {
+            sd_lock();
+            recFile.flush();
+            sd_unlock();
+        }
+
+        play_serve();
+    }
+}
+
+/*
+ * Player
+ */
+
+bool play_available()
+{
+    return (recTask && playAvail && !recActive && !recCloseReq);
+}
+
+// Task: Carry out the latest request, then read ahead
+static void play_serve()
+{
+    uint32_t gen = __atomic_load_n(&playGen, __ATOMIC_ACQUIRE);
+    uint8_t  req = playReq;
+
+    if(gen != playDoneGen) {
+        sd_lock();
+        if(req != PLAY_REQ_REWIND) {
+            playFile.close();
+        }
+        if(req == PLAY_REQ_OPEN) {
+            playFile = SD.open(REC_FILENAME, FILE_READ);
+        } else if(req == PLAY_REQ_REWIND && playFile) {
+            playFile.seek(0);
+        }
+        sd_unlock();
+        // The loop doesn't read the buffer until playDoneGen is updated
+        playHead = playTail;
+        playEOF = false;
+        playErr = (req != PLAY_REQ_CLOSE && !playFile);
+        __atomic_store_n(&playDoneGen, gen, __ATOMIC_RELEASE);
+    }
+
+    while(playFile && !playEOF && gen == __atomic_load_n(&playGen, __ATOMIC_ACQUIRE)) {
+        uint32_t head = playHead;
+        uint32_t hoff = head & (PLAY_RB_SIZE - 1);
+        uint32_t len = PLAY_RB_SIZE - (head - __atomic_load_n(&playTail, __ATOMIC_ACQUIRE));
+        int n;
+
+        if(len < PLAY_CHUNK_SIZE)
+            break;
+        if(len > PLAY_RB_SIZE - hoff) len = PLAY_RB_SIZE - hoff;
+        if(len > PLAY_CHUNK_SIZE) len = PLAY_CHUNK_SIZE;
+
+        sd_lock();
+        n = playFile.read(playRB + hoff, len);
+        sd_unlock();
+
+        if(n <= 0) {
+            __atomic_store_n(&playEOF, true, __ATOMIC_RELEASE);
+            break;
+        }
+        __atomic_store_n(&playHead, head + n, __ATOMIC_RELEASE);
+    }
+}
+
+// Loop: Hand a request to the task
+static void play_request(uint8_t req)
+{
+    playReq = req;
+    __atomic_store_n(&playGen, playGen + 1, __ATOMIC_RELEASE);
+    xTaskNotifyGive(recTask);
+}
+
+// Bytes in the buffer; *eof is true if no more will come
+static uint32_t play_avail(bool *eof)
+{
+    *eof = __atomic_load_n(&playEOF, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&playHead, __ATOMIC_ACQUIRE) - playTail;
+}
+
+static uint8_t play_peek(uint32_t i)
+{
+    return playRB[(playTail + i) & (PLAY_RB_SIZE - 1)];
+}
+
+// Wake the task to refill once half of the buffer is free
+static void play_consume(uint32_t len)
+{
+    uint32_t used = __atomic_load_n(&playHead, __ATOMIC_ACQUIRE) - playTail;
+
+    __atomic_store_n(&playTail, playTail + len, __ATOMIC_RELEASE);
+
+    if(used > PLAY_RB_SIZE / 2 && used - len <= PLAY_RB_SIZE / 2) {
+        xTaskNotifyGive(recTask);
+    }
+}
+
+// Returns 1 if the header is valid, 0 if it isn't in the buffer yet,
+// -1 if the recording is bad
+static int play_readHeader()
+{
+    bool eof;
+
+    if(play_avail(&eof) < REC_HDR_SIZE)
+        return eof ? -1 : 0;
+
+    if(play_peek(0) != 'F' || play_peek(1) != 'C' || play_peek(2) != 'R' ||
+       play_peek(3) != REC_VERSION || play_peek(4) != numChans) {
+        log_msg(LOG_PLAY_BAD);
+        return -1;
+    }
+
+    play_consume(REC_HDR_SIZE);
+
+    return 1;
+}
+
+// Read next record; returns 1 if read, 0 if it isn't complete in
+// the buffer yet, -1 at EOF or on bad data
+static int play_readRecord()
+{
+    bool     eof;
+    uint32_t avail = play_avail(&eof), pos = 0;
+    uint32_t delta = 0;
+    int c, shift = 0;
+
+    do {
+        if(pos >= avail) return eof ? -1 : 0;
+        if(shift > 28) return -1;
+        c = play_peek(pos++);
+        delta |= (uint32_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while(c & 0x80);
+
+    if(pos + maskLen > avail) return eof ? -1 : 0;
+    for(int i = 0; i < maskLen; i++) {
+        playMask[i] = play_peek(pos++);
+    }
+
+    for(int i = 0; i < numChans; i++) {
+        if(playMask[i >> 3] & (1 << (i & 7))) {
+            if(pos >= avail) return eof ? -1 : 0;
+            playVals[i] = play_peek(pos++);
+        }
+    }
+
+    play_consume(pos);
+
+    playNextTime += delta;
+    playHavePending = true;
+
+    return 1;
+}
+
+bool play_start()
+{
+    if(playing)
+        return true;
+
+    if(!play_available())
+        return false;
+
+    playHdrDone = false;
+    playHavePending = false;
+    playNextTime = 0;
+    playRestart = true;
+    play_request(PLAY_REQ_OPEN);
+
+    playing = true;
+
+    log_msg(LOG_PLAY_STARTED);
+
+    return true;
+}
+
+void play_stop()
+{
+    if(!playing)
+        return;
+
+    play_request(PLAY_REQ_CLOSE);
+    playing = false;
+
+    log_msg(LOG_PLAY_STOPPED);
+}
+
+static void play_fail()
+{
+    play_stop();
+    playAvail = false;
+}
+
+bool play_isPlaying()
+{
+    return playing;
+}
+
+/*
+ * Apply all records that are due to frame. Returns true
+ * if frame was changed.
+ */
+bool play_loop(uint8_t *frame)
+{
+    unsigned long now = millis();
+    bool changed = false;
+
+    int res;
+
+    if(!playing)
+        return false;
+
+    // Wait for the task to open or rewind the file
+    if(__atomic_load_n(&playDoneGen, __ATOMIC_ACQUIRE) != playGen)
+        return false;
+
+    if(playErr) {
+        play_fail();
+        return false;
+    }
+
+    if(!playHdrDone) {
+        if((res = play_readHeader()) <= 0) {
+            if(res < 0) play_fail();
+            return false;
+        }
+        playHdrDone = true;
+        if(playRestart) {
+            playBase = now;
+            playRestart = false;
+        }
+    }
+
+    for(;;) {
+
+        if(!playHavePending) {
+            if(!(res = play_readRecord()))
+                break;
+            if(res < 0) {
+                // End of recording: Loop, keeping timing seamless
+                if(!playNextTime) {
+                    play_fail();
+                    break;
+                }
+                playBase += playNextTime;
+                playNextTime = 0;
+                playHdrDone = false;
+                play_request(PLAY_REQ_REWIND);
+                break;
+            }
+        }
+
+        if(now - playBase < playNextTime)
+            break;
+
+        for(int i = 0; i < numChans; i++) {
+            if(playMask[i >> 3] & (1 << (i & 7))) {
+                frame[i] = playVals[i];
+                changed = true;
+            }
+        }
+        playHavePending = false;
+    }
+
+    return changed;
+}
+
+#endif  // FC_HAVE_RECORDER
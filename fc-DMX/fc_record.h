@@ -0,0 +1,29 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_RECORD_H
+#define _FC_RECORD_H
+
+#ifdef FC_HAVE_RECORDER
+
+void rec_setup(int numChannels);
+
+void rec_start(const uint8_t *frame);
+void rec_stop();
+bool rec_isRecording();
+void rec_frame(const uint8_t *frame);
+
+bool play_available();
+bool play_start();
+void play_stop();
+bool play_isPlaying();
+bool play_loop(uint8_t *frame);
+
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#ifdef FC_HAVE_SCENES
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "fc_scene.h"
+#include "fc_log.h"
+
+/*
+ * Scene memory
+ *
+ * Up to SCENE_MAX scenes (channels 1 - SCENE_CHANNELS, which include
+ * the chase settings), stored in the NVS partition, one entry per
+ * scene. NVS spreads the writes over the partition.
+ */
+
+#define SCENE_NVS_NS    "fcscene"
+#define SCENE_VERSION   1
+
+struct sceneBlob {
+    uint16_t version;
+    uint16_t size;
+    uint8_t  win[SCENE_CHANNELS];
+};
+
+static void scene_key(uint8_t num, char *key)
+{
+    snprintf(key, 8, "s%d", num);
+}
+
+// Load scene num (1-SCENE_MAX); returns false if not stored
+bool scene_load(uint8_t num, uint8_t *win)
+{
+    Preferences prefs;
+    struct sceneBlob blob;
+    char key[8];
+    bool ret = false;
+
+    if(num < 1 || num > SCENE_MAX)
+        return false;
+
+    scene_key(num, key);
+
+    if(!prefs.begin(SCENE_NVS_NS, true))
+        return false;
+
+    if((prefs.getBytesLength(key) == sizeof(blob)) &&
+       (prefs.getBytes(key, &blob, sizeof(blob)) == sizeof(blob)) &&
+       (blob.version == SCENE_VERSION) &&
+       (blob.size == SCENE_CHANNELS)) {
+        memcpy(win, blob.win, SCENE_CHANNELS);
+        ret = true;
+    }
+
+    prefs.end();
+
+    return ret;
+}
+
+bool scene_store(uint8_t num, const uint8_t *win)
+{
+    Preferences prefs;
+    struct sceneBlob blob;
+    char key[8];
+    bool ret;
+
+    if(num < 1 || num > SCENE_MAX)
+        return false;
+
+    scene_key(num, key);
+
+    blob.version = SCENE_VERSION;
+    blob.size = SCENE_CHANNELS;
+    memcpy(blob.win, win, SCENE_CHANNELS);
+
+    if(!prefs.begin(SCENE_NVS_NS, false))
+        return false;
+
+    ret = (prefs.putBytes(key, &blob, sizeof(blob)) == sizeof(blob));
+
+    prefs.end();
+
+    log_msg(ret ? LOG_SCENE_STORED : LOG_SCENE_FAILED, num);
+
+    return ret;
+}
+
+#endif  // FC_HAVE_SCENES
@@ -0,0 +1,22 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_SCENE_H
+#define _FC_SCENE_H
+
+#ifdef FC_HAVE_SCENES
+
+#define SCENE_MAX       64
+#define SCENE_CHANNELS  21      // ch1-ch21 are stored
+
+bool scene_load(uint8_t num, uint8_t *win);
+bool scene_store(uint8_t num, const uint8_t *win);
+
+#endif
+
+#endif
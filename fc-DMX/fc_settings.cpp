@@ -13,22 +13,93 @@
 #include <FS.h>
 
 #include <Update.h>
+#include <Preferences.h>
 
 #include "fc_settings.h"
 #include "fc_dmx.h"
 
 static const char *fwfn = "/fcfw.bin";     //"/fc-DMX.ino.nodemcu-32s.bin";
 static const char *fwfnold = "/fcfw.old";  //"/fc-DMX.ino.nodemcu-32s.old";
+static const char *cfgfn = "/fcconfig.txt";
 
-static bool haveSD = false;
+// NVS cache of the parsed config file
+#define CFG_NVS_NS    "fcdmx"
+#define CFG_NVS_KEY   "cfg"
+#define CFG_VERSION   2
+#define CFG_MAXSIZE   2048
+
+// Value ranges (config file and NVS)
+#define CFG_ADDR_MAX  (512 - DMX_CHANNELS_STD + 1)
+#define CFG_FREQ_MIN  100
+#define CFG_FREQ_MAX  40000
+
+struct cfgBlob {
+    uint16_t version;
+    uint16_t size;
+    uint32_t hash;          // FNV-1a of the config file
+    struct Settings s;
+};
+
+static const struct Settings defSettings = {
+    DEF_DMX_ADDRESS,
+    DEF_DMX_PERSONALITY,
+    DEF_LOSS_POLICY,
+    DEF_USE_VERIFY,
+    DEF_MONITOR,
+    DEF_CLED_FREQ,
+    DEF_BLED_FREQ
+};
+
+struct Settings settings = defSettings;
+
+static uint32_t cfgHash = 0;
+
+bool haveSD = false;
+
+// SD access from tasks (recorder, audio); see sd_lock()
+static SemaphoreHandle_t sdMutex = NULL;
 
 static bool firmware_update();
+static bool settings_valid(const struct Settings *s);
+static void read_config();
 static void unmount_fs();
 
+/*
+ * settings_load()
+ *
+ * Load settings from NVS. Only the binary blob stored after the last 
+ * config file change is read; the config file itself is checked
+ * in settings_setup().
+ */
+void settings_load()
+{
+    Preferences prefs;
+    struct cfgBlob blob;
+
+    if(!prefs.begin(CFG_NVS_NS, true))
+        return;
+
+    if((prefs.getBytesLength(CFG_NVS_KEY) == sizeof(blob)) &&
+       (prefs.getBytes(CFG_NVS_KEY, &blob, sizeof(blob)) == sizeof(blob)) &&
+       (blob.version == CFG_VERSION) && 
+       (blob.size == sizeof(struct Settings))) {
+        if(settings_valid(&blob.s)) {
+            settings = blob.s;
+            cfgHash = blob.hash;
+        } else {
+            // Defaults, until the config file is parsed again
+            Serial.println("Settings: Bad values in NVS, ignored");
+        }
+    }
+
+    prefs.end();
+}
+
 /*
  * settings_setup()
  * 
  * Mount SD (if available) and update firmware if available
+ * The SD card stays mounted if the recorder or audio is enabled.
  * 
  */
 void settings_setup()
@@ -81,7 +152,34 @@ void settings_setup()
             }
         }
 
+        read_config();
+
+        #if !defined(FC_HAVE_RECORDER) && !defined(FC_HAVE_AUDIO)
         unmount_fs();
+        #else
+        sdMutex = xSemaphoreCreateMutex();
+        #endif
+    }
+}
+
+/*
+ * The recorder's task and the audio task both use the SD card while
+ * it stays mounted; each of their file operations (open, read, write,
+ * seek, flush, close, remove, rename) holds the SD lock. Boot-time
+ * access (firmware update, config file, loading sounds before the
+ * tasks run) needs no lock.
+ */
+void sd_lock()
+{
+    if(sdMutex) {
+        xSemaphoreTake(sdMutex, portMAX_DELAY);
+    }
+}
+
+void sd_unlock()
+{
+    if(sdMutex) {
+        xSemaphoreGive(sdMutex);
     }
 }
 
@@ -137,6 +235,200 @@ static bool firmware_update()
     return false;
 }    
 
+/*
+ * Config file
+ *
+ * Plain text, one "key = value" per line, '#' starts a comment:
+ *
+ *   address     = 1-503          DMX start address (max 489 for
+ *                                Extended personality)
+ *   personality = 1-2            1 = Standard, 2 = Extended
+ *   loss        = hold|blackout  Behavior on loss of DMX signal
+ *   cledfreq    = 100-40000      Center LED PWM frequency (Hz)
+ *   bledfreq    = 100-40000      Box LED PWM frequency (Hz)
+ *   verify      = 0|1            Packet verification
+ *   monitor     = 0|1            DMX monitor mode (FC_HAVE_SNIFFER)
+ *
+ * Missing keys take their default value. If the file contains any 
+ * error, it is ignored as a whole. The file is only parsed if its
+ * hash differs from the one stored with the settings in NVS.
+ */
+
+static uint32_t cfg_hash(const char *buf, size_t len)
+{
+    uint32_t hash = 2166136261UL;
+
+    while(len--) {
+        hash ^= (uint8_t)*buf++;
+        hash *= 16777619UL;
+    }
+
+    // 0 means "no config file"
+    return hash ? hash : 1;
+}
+
+static bool cfg_number(const char *val, uint32_t minVal, uint32_t maxVal, uint32_t& res)
+{
+    char *end;
+    
+    res = strtoul(val, &end, 10);
+    
+    return (end != val && !*end && res >= minVal && res <= maxVal);
+}
+
+static bool parse_config(char *buf, struct Settings *s)
+{
+    char *line, *next, *key, *val, *t;
+    int lineNo = 0;
+    uint32_t n;
+
+    for(line = buf; line; line = next) {
+
+        lineNo++;
+
+        if((next = strchr(line, '\n'))) {
+            *next++ = 0;
+        }
+        if((t = strchr(line, '#'))) *t = 0;
+
+        // Trim
+        while(*line == ' ' || *line == '\t') line++;
+        t = line + strlen(line);
+        while(t > line && (t[-1] == ' ' || t[-1] == '\t' || t[-1] == '\r')) *--t = 0;
+        
+        if(!*line)
+            continue;
+
+        if(!(val = strchr(line, '='))) {
+            Serial.printf("%s: Line %d: Syntax error\n", cfgfn, lineNo);
+            return false;
+        }
+        key = line;
+        t = val++;
+        while(t > key && (t[-1] == ' ' || t[-1] == '\t')) t--;
+        *t = 0;
+        while(*val == ' ' || *val == '\t') val++;
+
+        if(!strcmp(key, "address") && cfg_number(val, 1, CFG_ADDR_MAX, n)) {
+            s->dmxAddress = n;
+        } else if(!strcmp(key, "personality") && cfg_number(val, 1, DMX_PERS_MAX, n)) {
+            s->personality = n;
+        } else if(!strcmp(key, "loss") && !strcmp(val, "hold")) {
+            s->lossPolicy = LOSS_HOLD;
+        } else if(!strcmp(key, "loss") && !strcmp(val, "blackout")) {
+            s->lossPolicy = LOSS_BLACKOUT;
+        } else if(!strcmp(key, "cledfreq") && cfg_number(val, CFG_FREQ_MIN, CFG_FREQ_MAX, n)) {
+            s->cledFreq = n;
+        } else if(!strcmp(key, "bledfreq") && cfg_number(val, CFG_FREQ_MIN, CFG_FREQ_MAX, n)) {
+            s->bledFreq = n;
+        } else if(!strcmp(key, "verify") && cfg_number(val, 0, 1, n)) {
+            s->useVerify = n;
+        } else if(!strcmp(key, "monitor") && cfg_number(val, 0, 1, n)) {
+            s->monitor = n;
+        } else {
+            Serial.printf("%s: Line %d: Bad key or value\n", cfgfn, lineNo);
+            return false;
+        }
+    }
+
+    // All channels of the personality must be in the universe
+    if(s->dmxAddress + DMX_FOOTPRINT(s->personality) - 1 > 512) {
+        Serial.printf("%s: Address %d too high for personality %d\n", cfgfn, s->dmxAddress, s->personality);
+        return false;
+    }
+
+    if(dmx_addressConflict(s->dmxAddress, s->personality, s->useVerify)) {
+        Serial.printf("%s: Address %d covers verify/record channel (%d/%d)\n", cfgfn, 
+                      s->dmxAddress, DMX_VERIFY_CHANNEL, DMX_RECORD_CHANNEL);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * The same checks as parse_config() applies, for settings
+ * read back from NVS
+ */
+static bool settings_valid(const struct Settings *s)
+{
+    if(s->dmxAddress < 1 || s->dmxAddress > CFG_ADDR_MAX)
+        return false;
+    if(s->personality < 1 || s->personality > DMX_PERS_MAX)
+        return false;
+    if(s->lossPolicy != LOSS_HOLD && s->lossPolicy != LOSS_BLACKOUT)
+        return false;
+    if(s->useVerify > 1 || s->monitor > 1)
+        return false;
+    if(s->cledFreq < CFG_FREQ_MIN || s->cledFreq > CFG_FREQ_MAX ||
+       s->bledFreq < CFG_FREQ_MIN || s->bledFreq > CFG_FREQ_MAX)
+        return false;
+    if(s->dmxAddress + DMX_FOOTPRINT(s->personality) - 1 > 512)
+        return false;
+
+    return !dmx_addressConflict(s->dmxAddress, s->personality, s->useVerify);
+}
+
+static void read_config()
+{
+    Preferences prefs;
+    struct cfgBlob blob;
+    struct Settings newSettings = defSettings;
+    uint32_t hash;
+    char *buf;
+    size_t len;
+
+    File myFile = SD.open(cfgfn, FILE_READ);
+
+    if(!myFile)
+        return;
+
+    len = myFile.size();
+    if(len > CFG_MAXSIZE) {
+        Serial.printf("%s: File too large\n", cfgfn);
+        myFile.close();
+        return;
+    }
+
+    if(!(buf = (char *)malloc(len + 1))) {
+        myFile.close();
+        return;
+    }
+    len = myFile.read((uint8_t *)buf, len);
+    buf[len] = 0;
+    myFile.close();
+
+    hash = cfg_hash(buf, len);
+
+    if(hash != cfgHash) {
+        
+        if(parse_config(buf, &newSettings)) {
+
+            settings = newSettings;
+            cfgHash = hash;
+
+            blob.version = CFG_VERSION;
+            blob.size = sizeof(struct Settings);
+            blob.hash = hash;
+            blob.s = settings;
+            
+            if(prefs.begin(CFG_NVS_NS, false)) {
+                prefs.putBytes(CFG_NVS_KEY, &blob, sizeof(blob));
+                prefs.end();
+            }
+            
+            Serial.printf("%s: New configuration stored\n", cfgfn);
+            
+        } else {
+          
+            Serial.printf("%s: Ignored\n", cfgfn);
+            
+        }
+    }
+
+    free(buf);
+}
+
 static void unmount_fs()
 {
     if(haveSD) {
@@ -9,6 +9,41 @@
 #ifndef _FC_SETTINGS_H
 #define _FC_SETTINGS_H
 
+// DMX loss policy
+#define LOSS_HOLD       0     // Keep last look
+#define LOSS_BLACKOUT   1     // All outputs off
+
+// Defaults, used unless overruled by config file
+#define DEF_DMX_ADDRESS     47
+#define DEF_DMX_PERSONALITY DMX_PERS_STD
+#define DEF_LOSS_POLICY     LOSS_HOLD
+#define DEF_CLED_FREQ       5000
+#define DEF_BLED_FREQ       5000
+#ifdef DMX_USE_VERIFY
+#define DEF_USE_VERIFY      1
+#else
+#define DEF_USE_VERIFY      0
+#endif
+#define DEF_MONITOR         0
+
+struct Settings {
+    uint16_t dmxAddress;
+    uint8_t  personality;
+    uint8_t  lossPolicy;
+    uint8_t  useVerify;
+    uint8_t  monitor;
+    uint32_t cledFreq;
+    uint32_t bledFreq;
+};
+
+extern struct Settings settings;
+
+extern bool haveSD;
+
+void settings_load();
 void settings_setup();
 
+void sd_lock();
+void sd_unlock();
+
 #endif
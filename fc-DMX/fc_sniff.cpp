@@ -0,0 +1,238 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#include "fc_global.h"
+
+#ifdef FC_HAVE_SNIFFER
+
+#include <Arduino.h>
+#include <esp_dmx.h>
+#include <driver/gpio.h>
+
+#include "fc_sniff.h"
+
+/*
+ * DMX monitor ("sniffer")
+ *
+ * In monitor mode, the whole universe is received, and every packet is
+ * sent over the serial port as a record (see tools/fcsniff.py):
+ *
+ *   0xFC 0x5E <len lo> <len hi> <len bytes payload> <checksum>
+ *
+ * checksum: 8 bit sum of the payload bytes
+ *
+ * Payload:
+ *   <flags>              SNF_KEY, SNF_ERROR, SNF_TIMING, SNF_RAW
+ *   <timestamp, 4 bytes> micros() at packet reception
+ *   <size, 2 bytes>      number of slots incl. start code (or error code)
+ *   <dropped, 2 bytes>   records dropped so far (wraps)
+ *   [<break, 2 bytes> <mab, 2 bytes>]  in us, if SNF_TIMING
+ *   Runs: <skip (varint)> <count (varint)> <count bytes slot values>
+ *         until end of payload
+ *
+ * All multi-byte values are little endian. Runs hold the new values of
+ * changed slots (start code = slot 0); skip is the number of unchanged
+ * slots since the end of the previous run. A key record (SNF_KEY)
+ * holds all slots that differ from zero, the decoder clears its frame
+ * before applying it. Slots beyond the packet size are 0. Packets with
+ * a start code other than 0 are sent as SNF_RAW (a single run with all
+ * slots) and don't affect the frame.
+ *
+ * Records are only queued if the serial TX buffer has room, otherwise
+ * they are dropped and counted, and the next record is a key record.
+ *
+ * The port is shared with text output (which never contains 0xFC, see
+ * fc_global.h). Frame injection (FC_HAVE_INJECT) can't be built
+ * together with this.
+ */
+
+#define SNF_SYNC1       0xfc
+#define SNF_SYNC2       0x5e
+
+#define SNF_KEY         0x01
+#define SNF_ERROR       0x02
+#define SNF_TIMING      0x04
+#define SNF_RAW         0x08
+
+#define SNF_HDR_LEN     4
+#define SNF_FIX_LEN     (1 + 4 + 2 + 2 + 4)
+#define SNF_MAXREC      (SNF_HDR_LEN + SNF_FIX_LEN + 2 * DMX_PACKET_SIZE + 8)
+#define SNF_KEY_MS      5000        // Send key record at least this often
+#define SNF_MAXGAP      2           // Merge runs separated by max this many slots
+
+static dmx_port_t    snfPort;
+static uint8_t       snfCur[DMX_PACKET_SIZE];
+static uint8_t       snfLast[DMX_PACKET_SIZE];
+static uint8_t       snfRec[SNF_MAXREC];
+static bool          snfNeedKey = true;
+static unsigned long snfLastKey = 0;
+static uint16_t      snfDropped = 0;
+static bool          snfTiming = false;
+
+void sniff_setup(dmx_port_t port, int pin)
+{
+    snfPort = port;
+
+    gpio_install_isr_service(ESP_INTR_FLAG_EDGE | ESP_INTR_FLAG_IRAM);
+    snfTiming = dmx_sniffer_enable(port, pin);
+
+    Serial.printf("Monitor: Active%s\n", snfTiming ? "" : " (no break/MAB timing)");
+}
+
+static int put_varint(uint8_t *buf, uint32_t val)
+{
+    int len = 0;
+
+    do {
+        buf[len] = val & 0x7f;
+        val >>= 7;
+        if(val) buf[len] |= 0x80;
+        len++;
+    } while(val);
+
+    return len;
+}
+
+static void put16(uint8_t *buf, uint32_t val)
+{
+    buf[0] = val & 0xff;
+    buf[1] = (val >> 8) & 0xff;
+}
+
+static bool sniff_send(uint8_t *rec, int len)
+{
+    uint8_t sum = 0;
+    int plen = len - SNF_HDR_LEN;
+
+    for(int i = SNF_HDR_LEN; i < len; i++) {
+        sum += rec[i];
+    }
+    rec[len++] = sum;
+
+    rec[0] = SNF_SYNC1;
+    rec[1] = SNF_SYNC2;
+    put16(rec + 2, plen);
+
+    if(Serial.availableForWrite() < len) {
+        snfDropped++;
+        snfNeedKey = true;
+        return false;
+    }
+
+    Serial.write(rec, len);
+
+    return true;
+}
+
+// Fill in fixed part of payload, returns record length so far
+static int sniff_hdr(uint8_t flags, uint32_t ts, uint16_t size)
+{
+    dmx_metadata_t meta;
+    bool haveTiming = false;
+    int len = SNF_HDR_LEN;
+
+    // Use most recent timing; the sniffer queues one entry per packet
+    while(snfTiming && dmx_sniffer_get_data(snfPort, &meta, 0)) {
+        haveTiming = true;
+    }
+    if(haveTiming) flags |= SNF_TIMING;
+
+    snfRec[len++] = flags;
+    snfRec[len++] = ts & 0xff;
+    snfRec[len++] = (ts >> 8) & 0xff;
+    snfRec[len++] = (ts >> 16) & 0xff;
+    snfRec[len++] = ts >> 24;
+    put16(snfRec + len, size);
+    len += 2;
+    put16(snfRec + len, snfDropped);
+    len += 2;
+    if(haveTiming) {
+        put16(snfRec + len, meta.break_len > 0xffff ? 0xffff : meta.break_len);
+        put16(snfRec + len + 2, meta.mab_len > 0xffff ? 0xffff : meta.mab_len);
+        len += 4;
+    }
+
+    return len;
+}
+
+/*
+ * Called for every packet received without error; reads all
+ * size slots (including the start code) from the driver.
+ */
+void sniff_frame(int size, uint32_t ts)
+{
+    const uint8_t *data = snfCur;
+    int len, start, i, j, last;
+    bool key;
+
+    dmx_read(snfPort, snfCur, size);
+
+    if(data[0]) {
+        len = sniff_hdr(SNF_RAW, ts, size);
+        len += put_varint(snfRec + len, 0);
+        len += put_varint(snfRec + len, size);
+        memcpy(snfRec + len, data, size);
+        sniff_send(snfRec, len + size);
+        return;
+    }
+
+    key = snfNeedKey || (millis() - snfLastKey > SNF_KEY_MS);
+    if(key) {
+        memset(snfLast, 0, sizeof(snfLast));
+    }
+    // Slots beyond the end of a shorter packet count as 0
+    if(size < DMX_PACKET_SIZE) {
+        memset(snfLast + size, 0, DMX_PACKET_SIZE - size);
+    }
+
+    len = start = sniff_hdr(key ? SNF_KEY : 0, ts, size);
+
+    last = 0;
+    i = 0;
+    while(i < size) {
+        if(data[i] == snfLast[i]) {
+            i++;
+            continue;
+        }
+        // Extend run as long as there are changes with gaps <= SNF_MAXGAP
+        j = i + 1;
+        for(int k = j; k < size && k <= j + SNF_MAXGAP; k++) {
+            if(data[k] != snfLast[k]) j = k + 1;
+        }
+        len += put_varint(snfRec + len, i - last);
+        len += put_varint(snfRec + len, j - i);
+        memcpy(snfRec + len, data + i, j - i);
+        len += j - i;
+        last = i = j;
+
+        if(len - start > size + 6) {
+            // Worse than sending all slots
+            len = start;
+            len += put_varint(snfRec + len, 0);
+            len += put_varint(snfRec + len, size);
+            memcpy(snfRec + len, data, size);
+            len += size;
+            break;
+        }
+    }
+
+    memcpy(snfLast, data, size);
+
+    if(sniff_send(snfRec, len) && key) {
+        snfNeedKey = false;
+        snfLastKey = millis();
+    }
+}
+
+// Called for packets received with error
+void sniff_error(int err, uint32_t ts)
+{
+    sniff_send(snfRec, sniff_hdr(SNF_ERROR, ts, (uint16_t)err));
+}
+
+#endif  // FC_HAVE_SNIFFER
@@ -0,0 +1,20 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _FC_SNIFF_H
+#define _FC_SNIFF_H
+
+#ifdef FC_HAVE_SNIFFER
+
+void sniff_setup(dmx_port_t port, int pin);
+void sniff_frame(int size, uint32_t ts);
+void sniff_error(int err, uint32_t ts);
+
+#endif
+
+#endif
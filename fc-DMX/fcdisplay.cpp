@@ -9,8 +9,15 @@
 #include "fc_global.h"
 
 #include <Arduino.h>
+#ifdef FC_SR_USE_SPI
+#include <SPI.h>
+#include <soc/spi_struct.h>
+#endif
+#include <soc/gpio_struct.h>
 
 #include "fcdisplay.h"
+#include "fc_gen.h"
+#include "fc_log.h"
 
 /*
  * PWM LED class for Center and Box LEDs
@@ -44,11 +51,24 @@ void PWMLED::begin(uint8_t ledChannel, uint32_t freq, uint8_t resolution, uint8_
     setDC(0);
 }
 
+void PWMLED::setFreq(uint32_t freq)
+{
+    if(freq != _freq) {
+        _freq = freq;
+        ledcChangeFrequency(_chnl, _freq, _res);
+    }
+}
+
 void PWMLED::setDC(uint32_t dutyCycle)
 {
+    portENTER_CRITICAL(&_strobeMux);
     _curDutyCycle = dutyCycle;
-    ledcWrite(_chnl, dutyCycle);
-    //ledcWrite(_pwm_pin, dutyCycle); // For 3.x
+    // While strobing, the strobe ISR applies the DC in the "on" phase
+    if(!_strobeActive || _strobeOn) {
+        ledcWrite(_chnl, dutyCycle);
+        //ledcWrite(_pwm_pin, dutyCycle); // For 3.x
+    }
+    portEXIT_CRITICAL(&_strobeMux);
 }
 
 uint32_t PWMLED::getDC()
@@ -56,6 +76,111 @@ uint32_t PWMLED::getDC()
     return _curDutyCycle;
 }
 
+/*
+ * Strobe
+ *
+ * The on/off timing is generated by a hardware timer (1us resolution)
+ * in auto-reload mode; the ISR only alternates the alarm value between
+ * on and off time, so ISR latency does not accumulate. New parameters
+ * are applied at the start of the next cycle, keeping the strobe phase
+ * stable regardless of DMX frame timing.
+ */
+
+#define STROBE_PRESCALE  80     // 80MHz / 80 = 1MHz = 1us
+#define STROBE_MIN_PHASE 100    // Minimum on/off time in us
+#define STROBE_MAX_LEDS  2
+
+static PWMLED *strobeLEDs[STROBE_MAX_LEDS];
+static int numStrobeLEDs = 0;
+
+static void IRAM_ATTR strobeISR0()
+{
+    strobeLEDs[0]->strobeTick();
+}
+
+static void IRAM_ATTR strobeISR1()
+{
+    strobeLEDs[1]->strobeTick();
+}
+
+void PWMLED::beginStrobe(uint8_t timer_no)
+{
+    if(numStrobeLEDs >= STROBE_MAX_LEDS)
+        return;
+
+    strobeLEDs[numStrobeLEDs] = this;
+
+    _strobeTimer = timerBegin(timer_no, STROBE_PRESCALE, true);
+    timerAttachInterrupt(_strobeTimer, numStrobeLEDs ? &strobeISR1 : &strobeISR0, true);
+
+    numStrobeLEDs++;
+}
+
+// period, onTime in us; period 0 = strobe off
+void PWMLED::setStrobe(uint32_t period, uint32_t onTime)
+{
+    if(!_strobeTimer)
+        return;
+
+    if(!period) {
+        if(_strobeActive) {
+            timerAlarmDisable(_strobeTimer);
+            portENTER_CRITICAL(&_strobeMux);
+            _strobeActive = _strobeNew = false;
+            ledcWrite(_chnl, _curDutyCycle);
+            portEXIT_CRITICAL(&_strobeMux);
+        }
+        return;
+    }
+
+    if(period < 2 * STROBE_MIN_PHASE) period = 2 * STROBE_MIN_PHASE;
+    if(onTime < STROBE_MIN_PHASE) onTime = STROBE_MIN_PHASE;
+    if(onTime > period - STROBE_MIN_PHASE) onTime = period - STROBE_MIN_PHASE;
+
+    portENTER_CRITICAL(&_strobeMux);
+    if(_strobeActive) {
+        _nextPeriod = period;
+        _nextOnTime = onTime;
+        _strobeNew = true;
+        portEXIT_CRITICAL(&_strobeMux);
+        return;
+    }
+    _strobePeriod = period;
+    _strobeOnTime = onTime;
+    _strobeNew = false;
+    _strobeOn = true;
+    _strobeActive = true;
+    ledcWrite(_chnl, _curDutyCycle);
+    portEXIT_CRITICAL(&_strobeMux);
+
+    timerWrite(_strobeTimer, 0);
+    timerAlarmWrite(_strobeTimer, onTime, true);
+    timerAlarmEnable(_strobeTimer);
+}
+
+// ISR-helper: End of on or off phase
+void IRAM_ATTR PWMLED::strobeTick()
+{
+    portENTER_CRITICAL_ISR(&_strobeMux);
+    if(_strobeActive) {
+        if(_strobeOn) {
+            ledcWrite(_chnl, 0);
+            _strobeOn = false;
+            timerAlarmWrite(_strobeTimer, _strobePeriod - _strobeOnTime, true);
+        } else {
+            if(_strobeNew) {
+                _strobePeriod = _nextPeriod;
+                _strobeOnTime = _nextOnTime;
+                _strobeNew = false;
+            }
+            ledcWrite(_chnl, _curDutyCycle);
+            _strobeOn = true;
+            timerAlarmWrite(_strobeTimer, _strobeOnTime, true);
+        }
+    }
+    portEXIT_CRITICAL_ISR(&_strobeMux);
+}
+
 /*
  * FC LEDs class
  */
@@ -70,6 +195,7 @@ static volatile uint8_t  _reg_clk;
 static volatile uint8_t  _serdata;
 static volatile uint8_t  _mreset;
 static volatile uint32_t _ticks = 0;
+static volatile bool     _drawStep = true;   // Chase step to be latched
 static volatile bool     _critical = false;
 static volatile uint16_t _tick_interval = 100;
 static volatile bool     _fcledsoff = true;
@@ -78,6 +204,14 @@ static volatile bool     _fcstopped = false;
 #define SEQEND 0x80
 static volatile uint8_t  _seqType = 0;
 static volatile uint8_t  _index = 0;
+static volatile uint8_t  _seqLen = 6;
+static volatile uint16_t _tickInc = 256;     // Chase rate in 1/256 ticks per tick
+static volatile uint16_t _tickFrac = 0;
+static volatile uint32_t _genParams = 0;    // Procedural chase, 0 = off
+static volatile uint32_t _genPhase = 0;     // 16.8 fixed point
+static volatile uint32_t _genInc = 0;       // Phase increment per tick at nominal rate
+static volatile uint8_t  _genLast = 0xff;
+static portMUX_TYPE      _fcMux = portMUX_INITIALIZER_UNLOCKED;
 static const DRAM_ATTR byte _array[] = {
         0b100000,
         0b010000,
@@ -181,44 +315,51 @@ static volatile bool _useStale = false;
 static volatile uint8_t _lastStale = 0;
 static volatile uint8_t _curStale = 0;
 
-#define SS_ONESHOT 0xfffe   // Always needs to have "all off" as last step
+/*
+ * Special sequences: All sequences packed into one table, each
+ * consisting of
+ *   <type> <pattern> <duration in ticks (1-255)> ... SS_END
+ * The start offsets are determined in begin().
+ */
+#define SS_ONESHOT 1        // Always needs to have "all off" as last step
 #define SS_LOOP    0
-#define SS_END     0xffff
+#define SS_END     0xff
 static volatile bool     _specialsig = false;
 static volatile bool     _wasSpecial = false;
 static volatile bool     _specialOS = false;
-static volatile uint8_t  _specialsignum = 0;
+static const byte * volatile _specialSeq = NULL;
 static volatile uint8_t  _specialidx = 0;
 static volatile int16_t  _specialticks = 0;
-static const DRAM_ATTR uint16_t _specialArray[FCSEQ_MAX][32] = {
-        {                                               // 1: startup
+static uint8_t           _specialOffs[FCSEQ_MAX];
+static const DRAM_ATTR byte _specialArray[] = {
+          // 1: startup
           #define SPD 20
           SS_ONESHOT,
           0b100000, SPD, 0b110000, SPD, 0b111000, SPD,
           0b111100, SPD, 0b111110, SPD, 0b111111, SPD*2,
           0b111110, SPD, 0b111100, SPD, 0b111000, SPD,
-          0b110000, SPD, 0b100000, SPD, SS_END
+          0b110000, SPD, 0b100000, SPD, SS_END,
           // No "all off" at end, never run when FC chase is off
           #undef SPD
-        },
-        {                                               // 2: error: no audio files installed (128)
+
+          // 2: error: no audio files installed (128)
           SS_ONESHOT,
           0b000000, 100, 
           0b000001, 100, 0b000000, 100,
-          0b000001, 100, 0b000000, 100, SS_END
-        },
-        {                                               // 3: wait: installing audio files / formatting FS / fw update
+          0b000001, 100, 0b000000, 100, SS_END,
+
+          // 3: wait: installing audio files / formatting FS / fw update
           SS_LOOP,
-          0b100000, 50, 0b000001, 50, SS_END
-        },
-        {
-          SS_ONESHOT,                                   // 4: error: Bad IR input (1)
+          0b100000, 50, 0b000001, 50, SS_END,
+
+          // 4: error: Bad IR input (1)
+          SS_ONESHOT,
           0b000000, 100,
           0b100000, 100, 0b000000, 100,
-          0b100000, 100, 0b000000, 100, SS_END
-        },
-        {
-          SS_ONESHOT,                                   // 5: Alarm (BTTFN/MQTT)
+          0b100000, 100, 0b000000, 100, SS_END,
+
+          // 5: Alarm (BTTFN/MQTT)
+          SS_ONESHOT,
           0b000111,  50, 
           0b111000,  50,
           0b000111,  50, 
@@ -228,42 +369,100 @@ static const DRAM_ATTR uint16_t _specialArray[FCSEQ_MAX][32] = {
           0b000111,  50, 
           0b111000,  50,
           0b000000,   1,
-          SS_END
-        },
-        {
-          SS_ONESHOT,                                   // 6: IR learning start
+          SS_END,
+
+          // 6: IR learning start
+          SS_ONESHOT,
           0b000000,  20,
           0b111111, 100, 0b000000, 100,
-          0b111111, 100, 0b000000,   1, SS_END
-        },
-        {
-          SS_ONESHOT,                                   // 7: IR learning ok, next
+          0b111111, 100, 0b000000,   1, SS_END,
+
+          // 7: IR learning ok, next
+          SS_ONESHOT,
           0b000000,  10,
           0b001100,  50, 0b000000,  50,
-          0b001100,  50, 0b000000,   1, SS_END
-        },
-        {
-          SS_ONESHOT,                                   // 8: IR learning finished
+          0b001100,  50, 0b000000,   1, SS_END,
+
+          // 8: IR learning finished
+          SS_ONESHOT,
           0b000000,  10,
           0b111111,  50, 0b000000,  50,
-          0b111111,  50, 0b000000,  50, SS_END
-        },
-        {
-          SS_LOOP,                                      // 9: Error when copying audio files
+          0b111111,  50, 0b000000,  50, SS_END,
+
+          // 9: Error when copying audio files
+          SS_LOOP,
           0b110000,  20, 0b000011,  20, SS_END
-        }
-};        
+};
+static_assert(sizeof(_specialArray) <= 256, "_specialOffs must be widened");
+
+#ifdef FC_SR_USE_SPI
+// Shift register driven by HSPI: SER = MOSI, SRCLK = SCK,
+// RCLK = hardware CS (rising edge at end of transfer latches)
+#define FC_SPI_BUS    HSPI
+#define FC_SPI_DEV    SPI2
+#define FC_SPI_FREQ   5000000
+static SPIClass fcSPI(FC_SPI_BUS);
+#endif
+
+#ifdef FC_LATENCY_STATS
+static volatile uint32_t _latchCount = 0;
+static volatile uint32_t _latchTime = 0;
+#endif
+
+// ISR-helper: Set GPIO output level. digitalWrite() lives in
+// flash, and the chase ISR must run while the flash cache is
+// disabled (SD/flash writes, firmware update).
+static inline __attribute__((always_inline)) void pinSet(uint8_t pin, bool high)
+{
+    if(pin < 32) {
+        if(high) GPIO.out_w1ts = 1UL << pin;
+        else     GPIO.out_w1tc = 1UL << pin;
+    } else {
+        if(high) GPIO.out1_w1ts.val = 1UL << (pin - 32);
+        else     GPIO.out1_w1tc.val = 1UL << (pin - 32);
+    }
+}
 
 // ISR-helper: Update shift register
 static void IRAM_ATTR updateShiftRegister(byte val)
 {
-    digitalWrite(_reg_clk, LOW);
+    #ifdef FC_SR_USE_SPI
+    // Only hand the byte to the SPI peripheral; it clocks out the
+    // data and pulses the latch by itself. Waiting is only required
+    // if the previous transfer (1.6us at 5MHz) is still running.
+    while(FC_SPI_DEV.cmd.usr);
+    FC_SPI_DEV.data_buf[0] = val;
+    FC_SPI_DEV.cmd.usr = 1;
+    #else
+    pinSet(_reg_clk, LOW);
     for(uint8_t i = 128; i != 0; i >>= 1) {
-        digitalWrite(_serdata, !!(val & i));
-        digitalWrite(_shift_clk, HIGH);
-        digitalWrite(_shift_clk, LOW);
+        pinSet(_serdata, !!(val & i));
+        pinSet(_shift_clk, HIGH);
+        pinSet(_shift_clk, LOW);
     }
-    digitalWrite(_reg_clk, HIGH);
+    pinSet(_reg_clk, HIGH);
+    #endif
+
+    #ifdef FC_LATENCY_STATS
+    _latchTime = micros();
+    _latchCount++;
+    #ifdef FC_LATENCY_PIN
+    pinSet(FC_LATENCY_PIN, HIGH);
+    pinSet(FC_LATENCY_PIN, LOW);
+    #endif
+    #endif
+}
+
+// ISR-helper: End special sequence and return to the current
+// look: Redraw pattern, continue chase with current step
+static void IRAM_ATTR specialEnd()
+{
+    _specialsig = false;
+    _ticks = 0;
+    _tickFrac = 0;
+    _drawStep = true;
+    _lastStale = 255;
+    _genLast = 0xff;
 }
 
 // ISR: Play sequences
@@ -277,22 +476,20 @@ static void IRAM_ATTR FCLEDTimer_ISR()
         // Special sequence for signalling
         if(_specialticks == 0) {
             _wasSpecial = true;
-            if(_specialArray[_specialsignum][_specialidx] == SS_END) {
+            if(_specialSeq[_specialidx] == SS_END) {
                  if(_specialOS) {
-                    _specialsig = false; 
-                    _ticks = 0;
-                    _index = 0;
+                    specialEnd();
                  } else {
                     _specialidx = 1; 
                  }
             }
             if(_specialsig) {
-                updateShiftRegister(_specialArray[_specialsignum][_specialidx]);
+                updateShiftRegister(_specialSeq[_specialidx]);
             }
         }
         if(_specialsig) {
             _specialticks++;
-            if(_specialticks >= _specialArray[_specialsignum][_specialidx + 1]) {
+            if(_specialticks >= _specialSeq[_specialidx + 1]) {
                 _specialticks = 0;
                 _specialidx += 2;
             }
@@ -320,23 +517,42 @@ static void IRAM_ATTR FCLEDTimer_ISR()
         if(_fcledsareoff) {
             _ticks = 0;
             _index = 0;
+            _drawStep = true;
+            _genPhase = 0;
+            _genLast = 0xff;
             _fcledsareoff = false;
         }
 
         if(_fcstopped)
             return;
 
+        if(_genParams) {
+            // Procedural chase: Evaluated on every tick
+            byte pat = fcgen_eval(_genParams, _genPhase >> 8);
+            if(pat != _genLast) {
+                updateShiftRegister(pat);
+                _genLast = pat;
+            }
+            _genPhase = (_genPhase + ((_genInc * _tickInc) >> 8)) & 0xffffff;
+            return;
+        }
+
         arr = chaseArrs[_seqType];
       
-        // Normal sequences
-        if(_ticks == 0) {
+        // Normal sequences: Latch each step once; at rates below
+        // nominal, _ticks stays 0 for more than one tick
+        if(_drawStep) {
             updateShiftRegister(*(arr + _index));
+            _drawStep = false;
         }
-        _ticks++;
+        _tickFrac += _tickInc;
+        _ticks += (_tickFrac >> 8);
+        _tickFrac &= 0xff;
         if(_ticks >= _tick_interval) {
             _ticks = 0;
             _index++;
             if(*(arr + _index) == SEQEND) _index = 0;
+            _drawStep = true;
         }
     }
 }
@@ -357,10 +573,24 @@ FCLEDs::FCLEDs(uint8_t timer_no, uint8_t shift_clk, uint8_t reg_clk, uint8_t ser
 
 void FCLEDs::begin()
 {   
+    #ifdef FC_SR_USE_SPI
+    fcSPI.begin(_shift_clk, -1, _serdata, _reg_clk);
+    fcSPI.setHwCs(true);
+    fcSPI.setFrequency(FC_SPI_FREQ);
+    fcSPI.setDataMode(SPI_MODE0);
+    fcSPI.setBitOrder(MSBFIRST);
+    // Sets up 8-bit transfers for updateShiftRegister()
+    fcSPI.write(0);
+    #else
     pinMode(_reg_clk, OUTPUT);
     pinMode(_shift_clk, OUTPUT);  
     pinMode(_serdata, OUTPUT);
+    #endif
     pinMode(_mreset, OUTPUT);
+    #if defined(FC_LATENCY_STATS) && defined(FC_LATENCY_PIN)
+    pinMode(FC_LATENCY_PIN, OUTPUT);
+    digitalWrite(FC_LATENCY_PIN, LOW);
+    #endif
     
     digitalWrite(_mreset, HIGH);
 
@@ -380,6 +610,12 @@ void FCLEDs::begin()
     chaseArrs[7] = _array7;
     chaseArrs[8] = _array8;
     chaseArrs[9] = _array9;
+
+    for(int i = 0, j = 0; i < FCSEQ_MAX; i++) {
+        _specialOffs[i] = j++;
+        while(_specialArray[j] != SS_END) j += 2;
+        j++;
+    }
     
     // Install & enable timer interrupt
     _FCLTimer_Cfg = timerBegin(_timer_no, TMR_PRESCALE, true);
@@ -409,9 +645,10 @@ void FCLEDs::setSpeed(uint16_t speed)
     if(speed < 1) speed = 1;
     _critical = true;
     _tick_interval = speed;
+    _genInc = (65536UL * 256) / (FCGEN_STEPS * speed);
     _critical = false;
     #ifdef FC_DBG
-    Serial.printf("fcdisplay: Setting speed %d\n", speed);
+    log_msg(LOG_FC_SPEED, speed);
     #endif
 }
 
@@ -422,24 +659,139 @@ uint16_t FCLEDs::getSpeed()
 
 void FCLEDs::setSequence(uint8_t seq)
 {
+    uint8_t len = 0;
+    
     if(seq > 9) seq = 0;
+    while(chaseArrs[seq][len] != SEQEND) len++;
+    
     _critical = true;
     _seqType = seq;
+    _seqLen = len;
     _ticks = 0;
     _index = 0;
+    _drawStep = true;
+    _critical = false;
+}
+
+/*
+ * Chase phase within the current sequence cycle (0-65535),
+ * including the fraction of the current step.
+ */
+uint16_t FCLEDs::getPhase()
+{
+    uint32_t idx, ticks, intv, len;
+
+    if(_genParams) {
+        return _genPhase >> 8;
+    }
+
+    // Consistent snapshot: The critical section holds off the
+    // ISR (which runs on this core) while the state is copied
+    portENTER_CRITICAL(&_fcMux);
+    idx = _index;
+    ticks = (_ticks << 8) | _tickFrac;
+    intv = _tick_interval;
+    len = _seqLen;
+    portEXIT_CRITICAL(&_fcMux);
+
+    intv <<= 8;
+    if(ticks >= intv) ticks = intv - 1;
+
+    return (uint16_t)((((uint64_t)(idx * intv + ticks)) << 16) / (len * intv));
+}
+
+/*
+ * Move the running chase to the given phase (as returned
+ * by getPhase()), and show the corresponding step.
+ */
+void FCLEDs::setPhase(uint16_t phase)
+{
+    uint32_t intv, pos, idx;
+
+    _critical = true;
+    if(_genParams) {
+        _genPhase = (uint32_t)phase << 8;
+        _genLast = 0xff;
+        _critical = false;
+        return;
+    }
+
+    intv = (uint32_t)_tick_interval << 8;
+    pos = (uint32_t)(((uint64_t)phase * _seqLen * intv) >> 16);
+    idx = pos / intv;
+    pos -= idx * intv;
+    _index = idx;
+    _ticks = pos >> 8;
+    _tickFrac = pos & 0xff;
+    if(!_specialsig && !_useStale && !_fcledsoff && !_fcstopped) {
+        updateShiftRegister(*(chaseArrs[_seqType] + _index));
+        _fcledsareoff = false;
+        _drawStep = false;
+    } else {
+        _drawStep = true;
+    }
     _critical = false;
 }
 
+/*
+ * Fine-tune chase speed: rate is in 1/256 ticks per timer
+ * tick, ie. 256 is nominal speed.
+ */
+void FCLEDs::setRate(uint16_t rate)
+{
+    _tickInc = rate;
+}
+
+/*
+ * Switch procedural chase on/off (params = 0) or change its
+ * parameters (see fc_gen.h). Parameter changes are a single
+ * store, the ISR is never held off for them.
+ */
+void FCLEDs::setGenerator(uint32_t params)
+{
+    if(!params == !_genParams) {
+        _genParams = params;
+        return;
+    }
+
+    // Switching between sequence and generator: Keep phase
+    if(params) {
+        uint32_t phase = getPhase();
+        _critical = true;
+        _genPhase = phase << 8;
+        _genLast = 0xff;
+        _genParams = params;
+        _critical = false;
+    } else {
+        _critical = true;
+        _genParams = 0;
+        _ticks = 0;
+        _index = 0;
+        _drawStep = true;
+        _critical = false;
+    }
+}
+
 // Special sequences
 
+/*
+ * Play special sequence signum (1-FCSEQ_MAX) on top of the current
+ * look, replacing a running one; 0 stops a running sequence. After
+ * the sequence, the look is shown again and the chase continues.
+ */
 void FCLEDs::SpecialSignal(uint8_t signum)
 {
+    if(signum > FCSEQ_MAX)
+        return;
+
     _critical = true;
-    _specialsig = false;
+    if(_specialsig) {
+        specialEnd();
+    }
     _fcledsareoff = false;
     if(signum) {
-        _specialsignum = signum - 1;
-        _specialOS = (_specialArray[_specialsignum][0] == SS_ONESHOT);
+        _specialSeq = _specialArray + _specialOffs[signum - 1];
+        _specialOS = (_specialSeq[0] == SS_ONESHOT);
         _specialidx = 1;
         _specialticks = 0;
         _specialsig = true;
@@ -464,7 +816,92 @@ void FCLEDs::setCurPattern(uint8_t pattern)
 void FCLEDs::clearCurPattern()
 {
     _critical = true;
+    if(_useStale) {
+        // Restart current chase step
+        _ticks = 0;
+        _drawStep = true;
+        _genLast = 0xff;
+    }
     _useStale = false;
     _lastStale = 255;
     _critical = false;
 }
+
+/*
+ * Apply a pending pattern, or the current chase step after
+ * (re)starting the chase, immediately instead of on the next 
+ * timer tick. Used to update chase and PWM LEDs in sync.
+ */
+void FCLEDs::commit()
+{
+    _critical = true;
+    if(!_specialsig) {
+        if(_useStale) {
+            if(_lastStale != _curStale) {
+                updateShiftRegister(_curStale);
+                _lastStale = _curStale;
+            }
+        } else if(!_fcledsoff && !_fcstopped) {
+            if(_fcledsareoff) {
+                _ticks = 0;
+                _index = 0;
+                _drawStep = true;
+                _genPhase = 0;
+                _genLast = 0xff;
+                _fcledsareoff = false;
+            }
+            if(_genParams) {
+                byte pat = fcgen_eval(_genParams, _genPhase >> 8);
+                if(pat != _genLast) {
+                    updateShiftRegister(pat);
+                    _genLast = pat;
+                }
+            } else if(_drawStep) {
+                updateShiftRegister(*(chaseArrs[_seqType] + _index));
+                _drawStep = false;
+                _ticks = 1;
+            }
+        }
+    }
+    _critical = false;
+}
+
+// Returns true if the ISR has nothing (more) to do
+bool FCLEDs::isStatic()
+{
+    if(_specialsig)
+        return false;
+
+    if(_useStale)
+        return (_lastStale == _curStale);
+
+    if(_fcledsoff)
+        return (_fcledsareoff && !_wasSpecial);
+
+    return _fcstopped;
+}
+
+// Stop/restart timer interrupt while idle
+void FCLEDs::idle(bool doIdle)
+{
+    if(doIdle) {
+        timerAlarmDisable(_FCLTimer_Cfg);
+    } else {
+        // The counter kept running past the alarm value while the
+        // alarm was off; the alarm would only fire after it wrapped
+        timerWrite(_FCLTimer_Cfg, 0);
+        timerAlarmEnable(_FCLTimer_Cfg);
+    }
+}
+
+#ifdef FC_LATENCY_STATS
+uint32_t FCLEDs::getLatchCount()
+{
+    return _latchCount;
+}
+
+uint32_t FCLEDs::getLatchTime()
+{
+    return _latchTime;
+}
+#endif
@@ -20,8 +20,14 @@ class PWMLED {
         PWMLED(uint8_t pwm_pin);
         void begin(uint8_t ledChannel, uint32_t freq, uint8_t resolution, uint8_t pwm_pin = 255);
 
+        void setFreq(uint32_t freq);
+
         void setDC(uint32_t dutyCycle);
         uint32_t getDC();
+
+        void beginStrobe(uint8_t timer_no);
+        void setStrobe(uint32_t period, uint32_t onTime);
+        void strobeTick();
         
     private:
         uint8_t   _pwm_pin;
@@ -29,7 +35,17 @@ class PWMLED {
         uint32_t  _freq;
         uint8_t   _res;
 
-        uint32_t _curDutyCycle;
+        volatile uint32_t _curDutyCycle;
+
+        hw_timer_t *_strobeTimer = NULL;
+        portMUX_TYPE _strobeMux = portMUX_INITIALIZER_UNLOCKED;
+        volatile bool     _strobeActive = false;
+        volatile bool     _strobeOn = false;
+        volatile bool     _strobeNew = false;
+        volatile uint32_t _strobePeriod = 0;
+        volatile uint32_t _strobeOnTime = 0;
+        volatile uint32_t _nextPeriod = 0;
+        volatile uint32_t _nextOnTime = 0;
 };
 
 // Special sequences
@@ -65,11 +81,26 @@ class FCLEDs {
 
         void setSequence(uint8_t seq);
 
+        uint16_t getPhase();
+        void setPhase(uint16_t phase);
+        void setRate(uint16_t rate);
+
+        void setGenerator(uint32_t params);
+
         void SpecialSignal(uint8_t signum);
         bool SpecialDone();
 
         void setCurPattern(uint8_t pattern);
         void clearCurPattern();
+        void commit();
+
+        bool isStatic();
+        void idle(bool doIdle);
+
+        #ifdef FC_LATENCY_STATS
+        uint32_t getLatchCount();
+        uint32_t getLatchTime();
+        #endif
         
     private:
         hw_timer_t *_FCLTimer_Cfg = NULL;
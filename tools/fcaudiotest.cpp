@@ -0,0 +1,539 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host test for DMX-triggered sound playback (fc_audio.cpp)
+ *
+ * Build & run:
+ *   g++ -O2 -I host -o fcaudiotest fcaudiotest.cpp && ./fcaudiotest [-v]
+ *
+ * Compiles fc_audio.cpp against stubs of SD and I2S, and runs the
+ * audio task on a virtual clock. The I2S stub models the DMA buffers:
+ * i2s_write() waits for a free DMA buffer (or until its timeout),
+ * queues what fits, and the buffers are played out at the sample rate. Underruns are counted where the DMA ran dry
+ * between two writes. SD reads and opens take time, reads can return
+ * fewer bytes than asked for, and a read can stall.
+ *
+ * Checks per scenario: The output matches the WAV data sample by
+ * sample, the latency from trigger to first sample, and the underruns
+ * (none, unless a stall is injected; then the firmware must report
+ * them), and that audio_active() holds while output plays (and ends
+ * AUD_TAIL later). Over all scenarios, the task must hold the SD lock
+ * (sd_lock()) for every file operation. -v prints the firmware's
+ * serial output.
+ *
+ * Exits 1 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+#define FC_HAVE_AUDIO
+#include "../fc-DMX/fc_audio.cpp"
+
+// Virtual clock (us)
+
+static double vnow;
+
+// Trigger schedule; fired as time passes, as if from the DMX loop
+
+struct Trigger {
+    double  t;
+    uint8_t num;
+};
+static std::deque<Trigger> triggers;
+static std::vector<double> trigTimes;
+
+// I2S DMA model
+
+#define DMA_FRAMES  (AUD_DMA_BUFS * AUD_DMA_LEN)
+
+struct OutFrame {
+    double  t;
+    int16_t l, r;
+};
+
+static std::deque<int16_t> dma;         // queued samples (L, R)
+static std::vector<OutFrame> out;       // everything played
+static uint32_t i2sRate = 44100;
+static double   nextFrame;              // time of next DMA frame
+static bool     playing;                // data played since last write
+static bool     dry;                    // ran dry after having played
+static int      gaps;
+static int      inactive;               // frames played while !audio_active()
+
+static void fire_triggers()
+{
+    while(!triggers.empty() && triggers.front().t <= vnow) {
+        trigTimes.push_back(vnow);
+        audio_play(triggers.front().num);
+        triggers.pop_front();
+    }
+}
+
+static void advance_to(double t)
+{
+    while(nextFrame <= t) {
+        vnow = nextFrame;
+        fire_triggers();
+        if(dma.size()) {
+            OutFrame f = { vnow, dma[0], dma[1] };
+            out.push_back(f);
+            if(!audio_active()) inactive++;
+            dma.pop_front();
+            dma.pop_front();
+            playing = true;
+        } else if(playing) {
+            dry = true;
+        }
+        nextFrame += 1000000.0 / i2sRate;
+    }
+    if(t > vnow) vnow = t;
+    fire_triggers();
+}
+
+static void advance(double us)
+{
+    advance_to(vnow + us);
+}
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t *cfg, int qsize, void *queue)
+{
+    return (cfg->dma_buf_count * cfg->dma_buf_len == DMA_FRAMES) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t *pins)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2s_set_clk(i2s_port_t port, uint32_t rate, uint32_t bits, i2s_channel_t ch)
+{
+    // Restarts the output
+    i2sRate = rate;
+    dma.clear();
+    nextFrame = vnow + 1000000.0 / rate;
+    return ESP_OK;
+}
+
+static size_t dmaFree()
+{
+    return DMA_FRAMES - dma.size() / 2;
+}
+
+esp_err_t i2s_write(i2s_port_t port, const void *src, size_t size, size_t *written, TickType_t wait)
+{
+    const int16_t *s = (const int16_t *)src;
+    double until = (wait == portMAX_DELAY) ? INFINITY : vnow + wait * 1000.0;
+    size_t n;
+
+    if(size & 3 || size > DMA_FRAMES * 4) {
+        printf("FAIL: i2s_write() of %zu bytes\n", size);
+        exit(1);
+    }
+
+    // Room is made a DMA buffer at a time
+    while(dmaFree() < min(size / 4, (size_t)AUD_DMA_LEN)) {
+        if(nextFrame > until) {
+            advance_to(until);
+            *written = 0;
+            return ESP_ERR_TIMEOUT;
+        }
+        advance_to(nextFrame);
+    }
+
+    if(dry) {
+        gaps++;
+        dry = false;
+    }
+    n = min(size / 4, dmaFree());
+    dma.insert(dma.end(), s, s + n * 2);
+    *written = n * 4;
+
+    return ESP_OK;
+}
+
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port)
+{
+    dma.clear();
+    playing = dry = false;
+    return ESP_OK;
+}
+
+// SD model
+
+struct HostFile {
+    std::vector<uint8_t> data;
+};
+
+static std::map<std::string, HostFile> files;
+
+static double openUs = 20000;           // SD.open() (assumed)
+static double readUs = 150;             // per read(), plus
+static double byteUs = 0.5;             // per byte (2MB/s)
+static std::vector<int> shortReads;     // cycled max bytes per read
+static int    readCount;
+static int    stallRead = -1;           // this read stalls ...
+static double stallUs;                  // ... for this long
+
+// The task must hold the SD lock for every file operation (loading
+// the sounds at boot needs none)
+static bool sdHeld, inTask;
+static int  sdFaults;
+
+void sd_lock()
+{
+    if(sdHeld) sdFaults++;
+    sdHeld = true;
+}
+
+void sd_unlock()
+{
+    if(!sdHeld) sdFaults++;
+    sdHeld = false;
+}
+
+static void sd_access()
+{
+    if(inTask && !sdHeld) sdFaults++;
+}
+
+SDFS SD;
+
+File SDFS::open(const char *path, const char *mode)
+{
+    File f;
+    auto it = files.find(path);
+
+    sd_access();
+    advance(openUs);
+    if(it != files.end()) {
+        f.f = &it->second;
+        f.pos = 0;
+    }
+
+    return f;
+}
+
+File::operator bool() const
+{
+    return f != NULL;
+}
+
+size_t File::read(uint8_t *buf, size_t len)
+{
+    size_t n;
+
+    sd_access();
+    if(!f)
+        return 0;
+
+    n = min(len, f->data.size() - min((size_t)pos, f->data.size()));
+    if(shortReads.size()) {
+        n = min(n, (size_t)shortReads[readCount % shortReads.size()]);
+    }
+    advance(readUs + n * byteUs + (readCount == stallRead ? stallUs : 0));
+    readCount++;
+
+    memcpy(buf, &f->data[pos], n);
+    pos += n;
+
+    return n;
+}
+
+bool File::seek(uint32_t p)
+{
+    sd_access();
+    if(!f || p > f->data.size())
+        return false;
+    pos = p;
+    return true;
+}
+
+size_t File::size()
+{
+    return f ? f->data.size() : 0;
+}
+
+void File::close()
+{
+    sd_access();
+    f = NULL;
+}
+
+// Arduino, FreeRTOS
+
+HardwareSerial Serial;
+static std::string serialLog;
+static bool verbose;
+
+int HardwareSerial::printf(const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    serialLog += buf;
+    if(verbose) fputs(buf, stdout);
+
+    return n;
+}
+
+void HardwareSerial::println(const char *s)
+{
+    this->printf("%s\n", s);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)vnow;
+}
+
+int64_t esp_timer_get_time()
+{
+    return (int64_t)vnow;
+}
+
+bool haveSD = true;
+
+static void (*taskFunc)(void *);
+static int notified;
+
+struct TaskEnd { };
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *parm,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    taskFunc = fn;
+    *handle = (TaskHandle_t)&taskFunc;
+    return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    notified++;
+}
+
+// Blocks until the next trigger; ends the task if there is none
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    uint32_t res;
+
+    if(!notified) {
+        if(triggers.empty())
+            throw TaskEnd();
+        advance_to(triggers.front().t);
+    }
+    res = notified;
+    notified = clear ? 0 : notified - 1;
+
+    return res;
+}
+
+// Test data
+
+struct Wav {
+    uint32_t rate;
+    int chans;
+    std::vector<int16_t> smp;       // interleaved
+};
+
+static std::map<int, Wav> wavs;
+
+static void make_wav(int num, uint32_t rate, int chans, uint32_t frames)
+{
+    Wav &w = wavs[num];
+    std::vector<uint8_t> &d = files[std::string("/snd") + (char)('0' + num / 100) +
+                                    (char)('0' + num / 10 % 10) + (char)('0' + num % 10) + ".wav"].data;
+    uint32_t lcg = num;
+    uint32_t dlen = frames * chans * 2;
+
+    w.rate = rate;
+    w.chans = chans;
+    for(uint32_t i = 0; i < frames * chans; i++) {
+        lcg = lcg * 1664525 + 1013904223;
+        w.smp.push_back((int16_t)(lcg >> 16));
+    }
+
+    auto put32 = [&](uint32_t v) { for(int i = 0; i < 4; i++) d.push_back(v >> (i * 8)); };
+    auto put16 = [&](uint16_t v) { d.push_back(v); d.push_back(v >> 8); };
+    auto tag   = [&](const char *t) { d.insert(d.end(), t, t + 4); };
+
+    tag("RIFF"); put32(4 + 8 + 16 + 8 + 6 + 8 + dlen); tag("WAVE");
+    tag("fmt "); put32(16);
+    put16(1); put16(chans); put32(rate); put32(rate * chans * 2); put16(chans * 2); put16(16);
+    tag("LIST"); put32(5); tag("INFO"); d.push_back('x'); d.push_back(0);  // odd, padded
+    tag("data"); put32(dlen);
+    for(int16_t s : w.smp) put16(s);
+}
+
+// Expected output: stereo, volume applied. The data length is
+// truncated to whole 4-byte units (a mono file may lose its last
+// sample).
+static std::vector<OutFrame> expected(int num, uint8_t vol)
+{
+    const Wav &w = wavs[num];
+    std::vector<OutFrame> res;
+
+    for(size_t i = 0; i < (w.smp.size() & ~(size_t)1); i += w.chans) {
+        OutFrame f = { 0, (int16_t)((w.smp[i] * vol) >> 8), (int16_t)((w.smp[i + w.chans - 1] * vol) >> 8) };
+        res.push_back(f);
+    }
+
+    return res;
+}
+
+static bool same(const OutFrame *a, const OutFrame *b, size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        if(a[i].l != b[i].l || a[i].r != b[i].r)
+            return false;
+    }
+    return true;
+}
+
+// Scenarios
+
+static int failed;
+
+static void check(bool ok, const char *what)
+{
+    printf("  %-48s %s\n", what, ok ? "ok" : "FAIL");
+    if(!ok) failed++;
+}
+
+static void run(const char *name, std::vector<Trigger> trig, uint8_t vol = 255)
+{
+    printf("%s\n", name);
+
+    vnow = nextFrame = 0;
+    dma.clear();
+    out.clear();
+    playing = dry = false;
+    gaps = inactive = 0;
+    readCount = 0;
+    notified = 0;
+    serialLog.clear();
+    triggers.assign(trig.begin(), trig.end());
+    trigTimes.clear();
+    audio_volume(vol);
+
+    inTask = true;
+    try {
+        taskFunc(NULL);
+    } catch(TaskEnd&) { }
+    inTask = false;
+
+    // Play what is left in the DMA buffers
+    advance(DMA_FRAMES * 1000000.0 / i2sRate + 1000);
+}
+
+static double latency(size_t first, int trig)
+{
+    return out[first].t - trigTimes[trig];
+}
+
+// Time until the DMA plays the next frame at most
+static double oneFrame(uint32_t rate)
+{
+    return ceil(1000000.0 / rate);
+}
+
+int main(int argc, char *argv[])
+{
+    char buf[128];
+
+    verbose = (argc > 1 && !strcmp(argv[1], "-v"));
+
+    make_wav(1, 22050, 1, 11025);       // 0.5s mono
+    make_wav(2, 44100, 2, 17640);       // 0.4s stereo
+    make_wav(3, 44100, 1, 800);         // shorter than the preload
+
+    audio_setup();
+    if(!taskFunc) {
+        printf("FAIL: audio_setup()\n");
+        return 1;
+    }
+
+    // Worst case from trigger to first sample when the task is busy:
+    // It notices the trigger after waiting for DMA room (AUD_WAIT) or
+    // after one SD read, then the DMA plays the next frame
+    double busyUs = max(AUD_WAIT * 1000.0, readUs + AUD_CHUNK * byteUs) + oneFrame(22050);
+
+    {
+        run("Mono, 22050Hz", { { 1000, 1 } });
+        auto exp = expected(1, 255);
+        check(out.size() == exp.size() && same(out.data(), exp.data(), exp.size()), "Output matches WAV data");
+        snprintf(buf, sizeof(buf), "Latency %.0fus (SD open %.0fus)", latency(0, 0), openUs);
+        check(latency(0, 0) <= oneFrame(22050), buf);
+        check(!gaps && serialLog.find("underrun") == std::string::npos, "No underruns");
+        advance(AUD_TAIL);
+        check(!inactive && !audio_active(), "Active while playing, not after");
+    }
+
+    {
+        shortReads = { 301, 127, 6, 511, 4, 257 };
+        run("Stereo, 44100Hz, short reads, volume 200", { { 0, 2 } }, 200);
+        auto exp = expected(2, 200);
+        check(out.size() == exp.size() && same(out.data(), exp.data(), exp.size()), "Output matches WAV data");
+        check(latency(0, 0) <= oneFrame(44100), "Latency within one frame");
+        check(!gaps && serialLog.find("underrun") == std::string::npos, "No underruns");
+        shortReads.clear();
+    }
+
+    {
+        stallRead = 20;
+        stallUs = 60000;
+        run("Stereo, 44100Hz, 60ms SD stall", { { 0, 2 } });
+        auto exp = expected(2, 255);
+        check(out.size() == exp.size() && same(out.data(), exp.data(), exp.size()), "Output matches WAV data");
+        snprintf(buf, sizeof(buf), "DMA ran dry (%d)", gaps);
+        check(gaps > 0, buf);
+        check(serialLog.find("buffer underruns") != std::string::npos, "Firmware reports underruns");
+        stallRead = -1;
+    }
+
+    {
+        run("Sound from preload only", { { 0, 3 } });
+        auto exp = expected(3, 255);
+        check(out.size() == exp.size() && same(out.data(), exp.data(), exp.size()), "Output matches WAV data");
+    }
+
+    {
+        run("Retrigger while streaming", { { 0, 1 }, { 150000, 2 } });
+        auto exp1 = expected(1, 255);
+        auto exp2 = expected(2, 255);
+        size_t first = out.size() - min(out.size(), exp2.size());
+        check(out.size() >= exp2.size() && same(&out[first], exp2.data(), exp2.size()), "Second sound complete");
+        check(first <= exp1.size() && same(out.data(), exp1.data(), first), "Preceded by start of first sound");
+        snprintf(buf, sizeof(buf), "Latency %.0fus (max %.0fus)", latency(first, 1), busyUs);
+        check(latency(first, 1) <= busyUs, buf);
+    }
+
+    {
+        run("Stop", { { 0, 1 }, { 100000, 0 } });
+        auto exp = expected(1, 255);
+        check(out.size() < exp.size() && same(out.data(), exp.data(), out.size()), "Output stops");
+        advance(AUD_TAIL);
+        check(!inactive && !audio_active(), "Active while playing, not after");
+        check(out.size() && out.back().t - trigTimes[1] <= busyUs, "Within max latency");
+    }
+
+    printf("All scenarios\n");
+    check(!sdFaults, "SD only used with the SD lock held");
+
+    printf(failed ? "%d check(s) failed\n" : "All checks passed\n", failed);
+
+    return failed ? 1 : 0;
+}
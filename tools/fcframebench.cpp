@@ -0,0 +1,142 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host benchmark for DMX frame ingestion (fc_frame.h)
+ *
+ * Build & run:
+ *   g++ -O2 -o fcframebench fcframebench.cpp && ./fcframebench
+ *
+ * Compares the former path (read the whole packet, memcmp against
+ * the cache, memcpy to the cache) with the windowed one (read start
+ * code, window, verify and record slot; single-pass compare; buffer
+ * swap). The driver's buffer is simulated by a plain array, so the
+ * cost of the driver's locking per read call is not included.
+ * Prints bytes copied and time (and TSC cycles on x86) per frame.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include "../fc-DMX/fc_frame.h"
+
+#define PACKET_SIZE     513
+#define FC_BASE         47
+#define VERIFY_SLOT     46
+#define RECORD_SLOT     45
+#define NUM_PACKETS     256     // distinct packets, replayed in a loop
+#define ITERATIONS      2000000
+
+static uint8_t packets[NUM_PACKETS][PACKET_SIZE];
+static unsigned long copied;
+
+// Stand-ins for the esp_dmx calls
+static void drv_read_offset(const uint8_t *pkt, int offs, void *dst, int len)
+{
+    memcpy(dst, pkt + offs, len);
+    copied += len;
+}
+
+static int drv_read_slot(const uint8_t *pkt, int slot)
+{
+    copied++;
+    return pkt[slot];
+}
+
+// Former path
+static uint8_t data[PACKET_SIZE];
+static uint8_t cache[DMX_CHANNELS];
+
+static int old_frame(const uint8_t *pkt)
+{
+    drv_read_offset(pkt, 0, data, PACKET_SIZE);
+    if(data[0] || data[VERIFY_SLOT] != 100)
+        return 0;
+    if(memcmp(cache, data + FC_BASE, DMX_CHANNELS)) {
+        memcpy(cache, data + FC_BASE, DMX_CHANNELS);
+        copied += DMX_CHANNELS;
+        return 1;
+    }
+    return 0;
+}
+
+// Windowed path
+static dmxFrame  frames[2];
+static dmxFrame *frmLive = &frames[0];
+static dmxFrame *frmNext = &frames[1];
+
+static int new_frame(const uint8_t *pkt)
+{
+    dmxFrame *f = frmNext;
+
+    f->startCode = drv_read_slot(pkt, 0);
+    if(f->startCode)
+        return 0;
+    drv_read_offset(pkt, FC_BASE, f->win, DMX_CHANNELS);
+    f->verify = drv_read_slot(pkt, VERIFY_SLOT);
+    f->record = drv_read_slot(pkt, RECORD_SLOT);
+    if(f->verify != 100)
+        return 0;
+    if(fcframe_diff(frmNext, frmLive)) {
+        frmNext = frmLive;
+        frmLive = f;
+        return 1;
+    }
+    return 0;
+}
+
+template<typename F> static void run(const char *name, F fn)
+{
+    unsigned long changes = 0;
+
+    copied = 0;
+    auto start = std::chrono::steady_clock::now();
+    #ifdef __x86_64__
+    uint64_t c0 = __rdtsc();
+    #endif
+    for(int i = 0; i < ITERATIONS; i++) {
+        changes += fn(packets[i & (NUM_PACKETS - 1)]);
+    }
+    #ifdef __x86_64__
+    uint64_t c1 = __rdtsc();
+    #endif
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+    printf("%-9s %6.1f bytes/frame  %6.2f ns/frame", name, (double)copied / ITERATIONS, ns);
+    #ifdef __x86_64__
+    printf("  %6.1f TSC cycles/frame", (double)(c1 - c0) / ITERATIONS);
+    #endif
+    printf("  (%lu applied)\n", changes);
+}
+
+int main()
+{
+    // A full universe; per packet, 0-3 slots of the FC's window change
+    srand(1);
+    for(int i = 0; i < PACKET_SIZE; i++) packets[0][i] = rand();
+    packets[0][0] = 0;
+    packets[0][VERIFY_SLOT] = 100;
+    for(int p = 1; p < NUM_PACKETS; p++) {
+        memcpy(packets[p], packets[p - 1], PACKET_SIZE);
+        for(int n = rand() % 4; n > 0; n--) {
+            packets[p][FC_BASE + rand() % DMX_CHANNELS] = rand();
+        }
+    }
+
+    for(int pass = 0; pass < 2; pass++) {
+        run("former", old_frame);
+        run("windowed", new_frame);
+    }
+
+    return 0;
+}
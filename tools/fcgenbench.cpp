@@ -0,0 +1,68 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host benchmark for the procedural chase generator (fc_gen.h)
+ *
+ * Build & run:
+ *   g++ -O2 -o fcgenbench fcgenbench.cpp && ./fcgenbench
+ *
+ * Prints the time per evaluation (ie per timer tick) for all
+ * combinations of waveform and mode, at several widths, and one
+ * cycle of patterns for visual inspection.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#define DRAM_ATTR
+#include "../fc-DMX/fc_gen.h"
+
+#define ITERATIONS 20000000
+
+static const char *waveNames[] = { "saw", "sine", "square", "random" };
+static const char *modeNames[] = { "out", "in", "out/bounce", "in/bounce" };
+
+int main()
+{
+    volatile uint32_t vparams;
+    volatile uint8_t sink;
+
+    for(int wave = 0; wave < 4; wave++) {
+        for(int mode = 0; mode < 4; mode++) {
+            for(int width = 0; width < 256; width += 127) {
+                uint32_t params;
+                uint32_t phase = 0;
+                uint8_t acc = 0;
+
+                vparams = FCGEN_PARAMS(wave, width, mode);
+                params = vparams;
+
+                auto start = std::chrono::steady_clock::now();
+                for(int i = 0; i < ITERATIONS; i++) {
+                    acc ^= fcgen_eval(params, phase);
+                    phase = (phase + 4099) & 0xffff;
+                }
+                auto end = std::chrono::steady_clock::now();
+                sink = acc;
+
+                double ns = std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+                printf("%-7s %-11s width %3d: %6.2f ns/tick\n", waveNames[wave], modeNames[mode], width, ns);
+            }
+        }
+    }
+
+    printf("\nsine, out/bounce, width 127, one cycle:\n");
+    for(int i = 0; i < 24; i++) {
+        uint8_t pat = fcgen_eval(FCGEN_PARAMS(FCGEN_SINE, 127, FCGEN_BOUNCE), i * 65536 / 24);
+        for(int b = 5; b >= 0; b--) putchar((pat >> b) & 1 ? '#' : '.');
+        putchar('\n');
+    }
+
+    (void)sink;
+    return 0;
+}
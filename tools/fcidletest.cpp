@@ -0,0 +1,84 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host test for the idle power save decision (fc_idle.h)
+ *
+ * Build & run:
+ *   g++ -O2 -o fcidletest fcidletest.cpp && ./fcidletest
+ *
+ * Checks fcidle_allowed() at the FC_IDLE_DELAY boundaries, across
+ * the wrap of millis(), and with recorder, audio and frame injection
+ * busy.
+ * Exits 1 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../fc-DMX/fc_idle.h"
+
+#define D FC_IDLE_DELAY
+
+struct Case {
+    const char *name;
+    uint32_t now, lastChange;
+    bool     isStatic, recBusy, audBusy, injActive;
+    uint32_t lastInjFrame;
+    bool     expect;
+};
+
+static const Case cases[] = {
+    { "Static, unchanged > delay",           100000, 100000 - D - 1, true,  false, false, false, 0,      true  },
+    { "Static, unchanged = delay",           100000, 100000 - D,     true,  false, false, false, 0,      false },
+    { "Static, changed recently",            100000, 99000,          true,  false, false, false, 0,      false },
+    { "Chase running",                       100000, 0,              false, false, false, false, 0,      false },
+    { "Boot, before delay",                  D,      0,              true,  false, false, false, 0,      false },
+    { "Boot, after delay",                   D + 1,  0,              true,  false, false, false, 0,      true  },
+    { "Sound playing",                       100000, 0,              true,  false, true,  false, 0,      false },
+    { "Recorder busy",                       100000, 0,              true,  true,  false, false, 0,      false },
+    { "Injected frame recently",             100000, 0,              true,  false, false, true,  99000,  false },
+    { "Injected frame = delay ago",          100000, 0,              true,  false, false, true,  100000 - D, true },
+    { "Injection inactive, stale time",      100000, 0,              true,  false, false, false, 99000,  true  },
+    { "millis() wrap, unchanged > delay",    1000,   (uint32_t)(1000 - D - 1), true,  false, false, false, 0,      true  },
+    { "millis() wrap, changed recently",     1000,   0xfffffc18,     true,  false, false, false, 0,      false },
+    { "millis() wrap, injected recently",    1000,   0,              true,  false, false, true,  0xfffffc18, false },
+    { "millis() wrap, injected long ago",    1000,   0xf0000000,     true,  false, false, true,  0xf0000000, true  },
+};
+
+int main()
+{
+    int failed = 0;
+
+    for(const Case &c : cases) {
+        bool res = fcidle_allowed(c.now, c.lastChange, c.isStatic, c.recBusy, c.audBusy, c.injActive, c.lastInjFrame);
+        printf("  %-40s %s\n", c.name, res == c.expect ? "ok" : "FAIL");
+        if(res != c.expect) failed++;
+    }
+
+    // Static look over ten minutes, output change at 60s: idle from
+    // 5s to 60s and from 65s on
+    uint32_t lastChange = 0, enter = 0, leave = 0;
+    bool idle = false;
+    for(uint32_t now = 0; now < 600000; now++) {
+        if(now == 60000) {
+            lastChange = now;
+            if(idle) leave = now;
+            idle = false;
+        }
+        if(!idle && fcidle_allowed(now, lastChange, true, false, false, false, 0)) {
+            idle = true;
+            enter = now;
+        }
+    }
+    bool ok = (idle && leave == 60000 && enter == 60000 + D + 1);
+    printf("  %-40s %s\n", "Timeline", ok ? "ok" : "FAIL");
+    if(!ok) failed++;
+
+    printf(failed ? "%d check(s) failed\n" : "All checks passed\n", failed);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+# -------------------------------------------------------------------
+# CircuitSetup.us Flux Capacitor - DMX-controlled
+# (C) 2024 Thomas Winischhofer (A10001986)
+# All rights reserved.
+# -------------------------------------------------------------------
+#
+# Send frames of the FC's slot window over the serial port.
+# Requires firmware built with FC_HAVE_INJECT, and pyserial.
+#
+# Examples:
+#   fcinject.py /dev/ttyUSB0 255 128 64 0 255 0 0 0 0 0
+#       Send one frame (ch1=255, ch2=128, ...)
+#   fcinject.py /dev/ttyUSB0 --fade --rate 200 --count 2000
+#       Fade Center LED up and down at 200 frames/s, print statistics
+#
+# Any serial device works as port, including a pty (eg from socat).
+
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+SYNC1, SYNC2, ACK = 0xFC, 0xD3, 0xA5
+STATUS = {0: "ok", 1: "CRC error", 2: "bad length"}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def build_frame(seq, values):
+    body = bytes([seq & 0xFF, len(values)]) + bytes(values)
+    return bytes([SYNC1, SYNC2]) + body + struct.pack("<H", crc16(body))
+
+
+class AckReader:
+    """Extract acks from the serial stream, skipping text output"""
+
+    def __init__(self, port):
+        self.port = port
+        self.buf = bytearray()
+
+    def poll(self):
+        acks = []
+        self.buf += self.port.read(self.port.in_waiting or 0)
+        while True:
+            i = self.buf.find(bytes([SYNC1, ACK]))
+            if i < 0:
+                del self.buf[:-1]
+                return acks
+            if len(self.buf) - i < 10:
+                del self.buf[:i]
+                return acks
+            seq, status, lat, ts = struct.unpack("<BBHI", self.buf[i + 2:i + 10])
+            acks.append((seq, status, lat, ts))
+            del self.buf[:i + 10]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Inject frames into a Flux Capacitor")
+    ap.add_argument("port")
+    ap.add_argument("values", nargs="*", type=int, help="channel values (ch1...)")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--fade", action="store_true", help="send a Center LED fade")
+    ap.add_argument("--rate", type=float, default=44.0, help="frames per second")
+    ap.add_argument("--count", type=int, default=1, help="number of frames")
+    args = ap.parse_args()
+
+    if not args.fade and not args.values:
+        ap.error("channel values or --fade required")
+
+    port = serial.Serial(args.port, args.baud, timeout=0)
+    reader = AckReader(port)
+    sent = {}
+    lats = []
+    errors = 0
+    period = 1.0 / args.rate
+    next_t = time.monotonic()
+
+    for n in range(args.count):
+        if args.fade:
+            v = n % 510
+            values = [255, v if v < 256 else 509 - v, 0, 0, 0, 0, 0, 0, 0, 0]
+        else:
+            values = args.values
+        seq = n & 0xFF
+        port.write(build_frame(seq, values))
+        sent[seq] = time.monotonic()
+        for aseq, status, lat, _ in reader.poll():
+            if status:
+                errors += 1
+                print("Frame %d: %s" % (aseq, STATUS.get(status, status)), file=sys.stderr)
+            else:
+                lats.append(lat)
+            sent.pop(aseq, None)
+        next_t += period
+        time.sleep(max(0.0, next_t - time.monotonic()))
+
+    # Collect outstanding acks
+    deadline = time.monotonic() + 0.5
+    while sent and time.monotonic() < deadline:
+        for aseq, status, lat, _ in reader.poll():
+            if status:
+                errors += 1
+            else:
+                lats.append(lat)
+            sent.pop(aseq, None)
+        time.sleep(0.01)
+
+    print("%d frames sent, %d acked ok, %d errors, %d unacknowledged" %
+          (args.count, len(lats), errors, len(sent)))
+    if lats:
+        lats.sort()
+        print("Apply latency (us): min %d, median %d, max %d" %
+              (lats[0], lats[len(lats) // 2], lats[-1]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+#
+# -------------------------------------------------------------------
+# CircuitSetup.us Flux Capacitor - DMX-controlled
+# (C) 2024 Thomas Winischhofer (A10001986)
+# All rights reserved.
+# -------------------------------------------------------------------
+#
+# Test for frame injection from the host: Builds the simulator
+# (fcsim.cpp), runs it with its serial port on a pty (-t), and sends
+# frames with fcinject.py. Checks fcinject.py's statistics (all frames
+# acked, no errors), and that the frames reached the outputs in the
+# simulator's timeline. Requires pyserial.
+#
+# Example:
+#   fcinjecttest.py [--cxx g++] [-v]
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+INJECT = os.path.join(HERE, "fcinject.py")
+
+FADE = 200
+
+
+def inject(args, port, name, opts, count):
+    res = subprocess.run([sys.executable, INJECT, port] + opts,
+                         stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    exp = "%d frames sent, %d acked ok, 0 errors, 0 unacknowledged" % (count, count)
+    ok = res.returncode == 0 and exp in res.stdout
+    print("  %-40s %s" % (name, "ok" if ok else "FAIL"))
+    if not ok or args.verbose:
+        print(res.stdout)
+    return ok
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Test fcinject.py against the simulator")
+    ap.add_argument("--cxx", default="g++")
+    ap.add_argument("-v", "--verbose", action="store_true", help="print the tools' output")
+    args = ap.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        sim = os.path.join(tmp, "fcsim")
+        script = os.path.join(tmp, "pty.fcs")
+        subprocess.run([args.cxx, "-O2", "-pthread", "-I", os.path.join(HERE, "host"), "-o", sim,
+                        os.path.join(HERE, "fcsim.cpp")], check=True)
+        with open(script, "w") as f:
+            f.write("end 5000\n")
+
+        proc = subprocess.Popen([sim, "-t", script], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                universal_newlines=True)
+        line = proc.stderr.readline()
+        m = re.match(r"fcsim: serial port (\S+)", line)
+        if not m:
+            print("FAIL: fcsim: " + line)
+            proc.kill()
+            return 1
+        port = m.group(1)
+
+        ok = inject(args, port, "Single frame", ["255", "128", "64", "0", "255", "0", "0", "0", "0", "0"], 1)
+        ok &= inject(args, port, "Fade, %d frames at 200/s" % FADE,
+                     ["--fade", "--rate", "200", "--count", str(FADE)], FADE)
+
+        timeline, _ = proc.communicate()
+        if args.verbose:
+            print(timeline)
+
+        cled = re.findall(r"CLED (\d+)", timeline)
+        acks = re.findall(r"TX fc a5 .. 00", timeline)
+        res = ("FC 100000" in timeline and "128" in cled and cled[-1] == str(FADE - 1) and
+               len(acks) == FADE + 1)
+        print("  %-40s %s" % ("Outputs follow the frames", "ok" if res else "FAIL"))
+        ok &= res
+
+    print("All checks passed" if ok else "Check(s) failed")
+
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,335 @@
+#!/usr/bin/env python3
+#
+# -------------------------------------------------------------------
+# CircuitSetup.us Flux Capacitor - DMX-controlled
+# (C) 2024 Thomas Winischhofer (A10001986)
+# All rights reserved.
+# -------------------------------------------------------------------
+#
+# ISR placement check. Walks the call graph of the ISRs that are
+# registered with ESP_INTR_FLAG_IRAM, starting at the linked ELF, and
+# reports every function reached that is not in IRAM (or ROM), and every
+# address loaded by that code that points into flash (rodata, strings,
+# const tables without DRAM_ATTR). Such code runs while the flash cache
+# is disabled (flash/NVS writes, firmware update) and crashes or stalls
+# on a cache miss. Also prints an IRAM/DRAM budget from the map file.
+#
+# Exits with 1 if there are violations not listed in the allow file
+# (default: fciramcheck.allow next to this script), so it can be hooked
+# into the build (see README).
+#
+# Requires the objdump of the ESP32 toolchain.
+#
+# Examples:
+#   fciramcheck.py build/fc-DMX.ino.elf build/fc-DMX.ino.map
+#   fciramcheck.py fc-DMX.ino.elf --root FCLEDTimer_ISR --root strobeISR0
+
+import argparse
+import bisect
+import glob
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+
+ROOTS = ["FCLEDTimer_ISR"]
+
+# ESP32 address map: (start, end, name, safe while flash cache is off)
+REGIONS = [
+    (0x3F400000, 0x3F800000, "DROM", False),   # flash, data
+    (0x3FF00000, 0x3FF80000, "DPORT", True),   # peripherals
+    (0x3FF80000, 0x3FF82000, "RTC", True),
+    (0x3FF90000, 0x3FFA0000, "ROM", True),     # mask ROM data
+    (0x3FFAE000, 0x40000000, "DRAM", True),
+    (0x40000000, 0x40070000, "ROM", True),     # mask ROM code
+    (0x40070000, 0x400A0000, "IRAM", True),
+    (0x400C0000, 0x400C2000, "RTC", True),
+    (0x400D0000, 0x40400000, "IROM", False),   # flash, code
+    (0x50000000, 0x50002000, "RTC", True),
+    (0x60000000, 0x60040000, "PERI", True),
+]
+
+CALL_RE = re.compile(r"^\s*([0-9a-f]+):\s+(call[0-9]*|j)\s+([0-9a-f]+) <(.*)>$")
+CALLX_RE = re.compile(r"^\s*([0-9a-f]+):\s+callx[0-9]+\s")
+L32R_RE = re.compile(r"^\s*([0-9a-f]+):\s+l32r\s+a[0-9]+, ([0-9a-f]+)")
+FUNC_RE = re.compile(r"^([0-9a-f]+) <(.*)>:$")
+SYM_RE = re.compile(r"^([0-9a-f]+) (.{7}) (\S+)\t([0-9a-f]+) (.*)$")
+MEM_RE = re.compile(r"^(\w+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+\w+)?$")
+INSEC_RE = re.compile(r"^ (\S+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+\.o\)?)$")
+
+
+def region(addr):
+    for start, end, name, safe in REGIONS:
+        if start <= addr < end:
+            return name, safe
+    return None, True
+
+
+class Elf:
+    """Minimal ELF32 little endian reader: section contents by address"""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError("%s: not a 32 bit little endian ELF file" % path)
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x2E)
+        raw = [struct.unpack_from("<IIIIII", self.data, shoff + i * shentsize)
+               for i in range(shnum)]
+        stroff = raw[shstrndx][4]
+        self.sections = []
+        for name, typ, flags, addr, offset, size in raw:
+            end = self.data.index(b"\0", stroff + name)
+            self.sections.append((self.data[stroff + name:end].decode(),
+                                  typ, flags, addr, offset, size))
+
+    def word(self, addr):
+        for name, typ, flags, saddr, offset, size in self.sections:
+            # SHF_ALLOC, not SHT_NOBITS
+            if flags & 2 and typ != 8 and saddr <= addr and addr + 4 <= saddr + size:
+                return struct.unpack_from("<I", self.data, offset + addr - saddr)[0]
+        return None
+
+
+def find_objdump(name):
+    if name and (os.path.isfile(name) or shutil.which(name)):
+        return name
+    for cand in ["xtensa-esp32-elf-objdump"]:
+        if shutil.which(cand):
+            return cand
+    hits = sorted(glob.glob(os.path.expanduser(
+        "~/.arduino15/packages/esp32/tools/xtensa-esp32-elf-gcc/*/bin/xtensa-esp32-elf-objdump")))
+    return hits[-1] if hits else None
+
+
+def objdump(tool, args, elf):
+    return subprocess.run([tool] + args + [elf], check=True, stdout=subprocess.PIPE,
+                          universal_newlines=True).stdout.splitlines()
+
+
+class Image:
+
+    def __init__(self, elf, tool):
+        self.elf = Elf(elf)
+
+        # Symbols: functions by start address, data objects for naming
+        self.funcs = {}
+        self.objs = []
+        for line in objdump(tool, ["-t", "-C"], elf):
+            m = SYM_RE.match(line)
+            if not m:
+                continue
+            addr, flags, size, name = int(m.group(1), 16), m.group(2), int(m.group(4), 16), m.group(5)
+            if flags[6] == "F":
+                self.funcs.setdefault(addr, name)
+            elif flags[6] == "O" and size:
+                self.objs.append((addr, size, name))
+        self.objs.sort()
+        self.objaddrs = [o[0] for o in self.objs]
+
+        # Per function: call targets, literal values, indirect calls
+        self.calls = {}
+        self.lits = {}
+        self.indirect = {}
+        cur = None
+        for line in objdump(tool, ["-d", "-C", "--no-show-raw-insn"], elf):
+            m = FUNC_RE.match(line)
+            if m:
+                addr = int(m.group(1), 16)
+                cur = addr if addr in self.funcs else None
+                if cur is not None:
+                    self.calls[cur] = []
+                    self.lits[cur] = []
+                    self.indirect[cur] = 0
+                continue
+            if cur is None:
+                continue
+            m = CALL_RE.match(line)
+            if m:
+                tgt = int(m.group(3), 16)
+                # Branches within a function are not calls
+                if tgt in self.funcs and tgt != cur:
+                    self.calls[cur].append(tgt)
+                continue
+            m = L32R_RE.match(line)
+            if m:
+                val = self.elf.word(int(m.group(2), 16))
+                if val is not None:
+                    self.lits[cur].append(val)
+                continue
+            if CALLX_RE.match(line):
+                self.indirect[cur] += 1
+
+    def objname(self, addr):
+        i = bisect.bisect_right(self.objaddrs, addr) - 1
+        if i >= 0 and addr < self.objs[i][0] + self.objs[i][1]:
+            o = self.objs[i]
+            return o[2] if addr == o[0] else "%s+0x%x" % (o[2], addr - o[0])
+        return "0x%08x" % addr
+
+    def find(self, root):
+        return [a for a, n in self.funcs.items()
+                if n == root or n.startswith(root + "(") or n.endswith("::" + root)
+                or ("::" + root + "(") in n]
+
+
+def walk(img, root, violations, warnings):
+    """Print the call tree below root, collect violations"""
+    seen = set()
+
+    def visit(addr, depth, via):
+        name = img.funcs[addr]
+        reg, safe = region(addr)
+        mark = "" if safe else "  <-- in flash"
+        if addr in seen:
+            print("  " * depth + "%s [%s] (see above)%s" % (name, reg, mark))
+            return
+        seen.add(addr)
+        print("  " * depth + "%s [%s]%s" % (name, reg, mark))
+        if not safe:
+            violations.append((name, "function in flash, called from %s" % via))
+        # No code for ROM functions in the ELF
+        if reg == "ROM":
+            return
+        if img.indirect.get(addr):
+            warnings.append("%s: %d indirect call(s), targets not checked"
+                            % (name, img.indirect[addr]))
+        callees = list(img.calls.get(addr, []))
+        for val in img.lits.get(addr, []):
+            if val in img.funcs:
+                # Address of a function: callx target (longcalls) or pointer
+                callees.append(val)
+            else:
+                vreg, vsafe = region(val)
+                if not vsafe:
+                    what = img.objname(val)
+                    print("  " * (depth + 1) + "-> %s [%s]  <-- in flash" % (what, vreg))
+                    violations.append((what, "data in flash, used by %s" % name))
+        done = set()
+        for c in callees:
+            if c not in done:
+                done.add(c)
+                visit(c, depth + 1, name)
+
+    visit(root, 0, "ISR")
+
+
+def budget(img, mapfile, top):
+    """Print usage of the map file's memory regions"""
+    regions = []
+    objsizes = {}
+    inmem = False
+    with open(mapfile, errors="replace") as f:
+        lines = f.read().splitlines()
+    for i, line in enumerate(lines):
+        if line.startswith("Memory Configuration"):
+            inmem = True
+            continue
+        if inmem:
+            if line.startswith("Linker script and memory map"):
+                inmem = False
+                continue
+            m = MEM_RE.match(line)
+            if m and m.group(1) != "Name":
+                regions.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16)))
+            continue
+        m = INSEC_RE.match(line)
+        if not m:
+            continue
+        # Section name on the preceding line if it was too long
+        secname = m.group(1) or lines[i - 1].strip()
+        if secname.startswith(".debug") or secname.startswith(".comment"):
+            continue
+        addr, size = int(m.group(2), 16), int(m.group(3), 16)
+        if size and addr:
+            obj = os.path.basename(m.group(4))
+            objsizes[(addr, obj)] = objsizes.get((addr, obj), 0) + size
+
+    print("\nMemory budget:")
+    for name, origin, length in regions:
+        if not length or name.startswith("*") or origin < 0x3F000000:
+            continue
+        used = 0
+        for sname, typ, flags, addr, offset, size in img.elf.sections:
+            if flags & 2 and origin <= addr < origin + length:
+                used += size
+        if not used:
+            continue
+        print("  %-16s %7d of %7d bytes used (%5.1f%%), %7d free"
+              % (name, used, length, 100.0 * used / length, length - used))
+        per = {}
+        for (addr, obj), size in objsizes.items():
+            if origin <= addr < origin + length:
+                per[obj] = per.get(obj, 0) + size
+        for obj, size in sorted(per.items(), key=lambda x: -x[1])[:top]:
+            print("      %7d  %s" % (size, obj))
+
+
+def load_allow(path):
+    allow = set()
+    if path and os.path.isfile(path):
+        with open(path) as f:
+            for line in f:
+                line = line.split("#", 1)[0].strip()
+                if line:
+                    allow.add(line)
+    return allow
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Check ISR code and data placement in an FC firmware ELF")
+    ap.add_argument("elf")
+    ap.add_argument("map", nargs="?", help="linker map file, for the memory budget")
+    ap.add_argument("--root", action="append", help="ISR to check (default: %s)" % ", ".join(ROOTS))
+    ap.add_argument("--allow", default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                   "fciramcheck.allow"),
+                    help="file listing accepted violations")
+    ap.add_argument("--objdump", help="objdump of the ESP32 toolchain")
+    ap.add_argument("--top", type=int, default=8, help="largest objects listed per memory region")
+    args = ap.parse_args()
+
+    tool = find_objdump(args.objdump)
+    if not tool:
+        sys.exit("fciramcheck: xtensa-esp32-elf-objdump not found, use --objdump")
+
+    img = Image(args.elf, tool)
+    allow = load_allow(args.allow)
+    violations = []
+    warnings = []
+    missing = False
+
+    for root in args.root or ROOTS:
+        addrs = img.find(root)
+        if not addrs:
+            print("fciramcheck: ISR %s not found in %s" % (root, args.elf))
+            missing = True
+            continue
+        for addr in addrs:
+            print("\nCall graph of %s:" % img.funcs[addr])
+            walk(img, addr, violations, warnings)
+
+    if args.map:
+        budget(img, args.map, args.top)
+
+    for w in sorted(set(warnings)):
+        print("Warning: %s" % w)
+
+    new = 0
+    for what, why in sorted(set(violations)):
+        if what in allow:
+            print("Allowed: %s (%s)" % (what, why))
+        else:
+            print("VIOLATION: %s (%s)" % (what, why))
+            new += 1
+
+    if new or missing:
+        print("fciramcheck: %d violation(s)%s" % (new, ", ISR missing" if missing else ""))
+        sys.exit(1)
+    print("fciramcheck: ok")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# -------------------------------------------------------------------
+# CircuitSetup.us Flux Capacitor - DMX-controlled
+# (C) 2024 Thomas Winischhofer (A10001986)
+# All rights reserved.
+# -------------------------------------------------------------------
+#
+# Test for fciramcheck.py. Builds fixture.c twice, with a call from
+# the ISR into flash and without, and checks fciramcheck.py's exit
+# code: 1 for the violation, 0 if the violation is in the allow file,
+# 0 for the clean build, 1 if the ISR is not found.
+#
+# The fixture is built for the host (gcc -m32, no libc) and checked
+# with the host's objdump, so this covers the call graph only; flash
+# data references are found from Xtensa l32r instructions.
+#
+# Example:
+#   fciramtest.py [--cc gcc] [--ld ld] [--objdump objdump]
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CHECK = os.path.join(HERE, "..", "fciramcheck.py")
+
+SECTIONS = [".iramtext=0x40080000", ".flashtext=0x400d0000", ".drom=0x3f400000"]
+
+
+def build(args, tmp, name, defs):
+    obj = os.path.join(tmp, name + ".o")
+    elf = os.path.join(tmp, name + ".elf")
+    subprocess.run([args.cc, "-m32", "-O1", "-fno-pie", "-ffreestanding", "-fno-asynchronous-unwind-tables"]
+                   + defs + ["-c", os.path.join(HERE, "fixture.c"), "-o", obj], check=True)
+    subprocess.run([args.ld, "-m", "elf_i386", obj, "-o", elf]
+                   + ["--section-start=" + s for s in SECTIONS], check=True)
+    return elf
+
+
+def run(args, name, elf, allow, expect, extra=()):
+    res = subprocess.run([sys.executable, CHECK, elf, "--objdump", args.objdump, "--allow", allow] + list(extra),
+                         stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    ok = res.returncode == expect
+    print("  %-40s exit %d %s" % (name, res.returncode, "ok" if ok else "FAIL"))
+    if not ok or args.verbose:
+        print(res.stdout)
+    return ok
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Test fciramcheck.py on a fixture")
+    ap.add_argument("--cc", default="gcc")
+    ap.add_argument("--ld", default="ld")
+    ap.add_argument("--objdump", default="objdump")
+    ap.add_argument("-v", "--verbose", action="store_true", help="print fciramcheck's output")
+    args = ap.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        bad = build(args, tmp, "bad", ["-DBAD"])
+        clean = build(args, tmp, "clean", [])
+        noallow = os.path.join(tmp, "none.allow")
+        allow = os.path.join(tmp, "flashfn.allow")
+        open(noallow, "w").close()
+        with open(allow, "w") as f:
+            f.write("# accepted\nflashfn\n")
+
+        results = [
+            run(args, "Call into flash", bad, noallow, 1),
+            run(args, "Call into flash, allowed", bad, allow, 0),
+            run(args, "Clean", clean, noallow, 0),
+            run(args, "ISR not found", clean, noallow, 1, ["--root", "strobeISR0"]),
+        ]
+
+    if not all(results):
+        print("fciramtest: %d test(s) failed" % results.count(False))
+        sys.exit(1)
+    print("fciramtest: ok")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,51 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Fixture for fciramtest.py: A minimal "firmware" whose ISR calls
+ * code in IRAM, and (if BAD is defined) through a helper in IRAM a
+ * function in flash. Linked for the host (x86, 32 bit) with the
+ * sections at ESP32 addresses; fciramcheck.py only uses the call
+ * instructions and the addresses, so the host's objdump will do.
+ */
+
+#define IRAM   __attribute__((section(".iramtext"), noinline))
+#define FLASH  __attribute__((section(".flashtext"), noinline))
+#define DROM   __attribute__((section(".drom")))
+
+DROM const int tbl[4] = { 1, 2, 3, 4 };
+int dram[4];
+
+FLASH int flashfn(int x)
+{
+    return x * 3 + tbl[x & 3];
+}
+
+IRAM int helper(int x)
+{
+    #ifdef BAD
+    return flashfn(x) + 1;
+    #else
+    return x + 1;
+    #endif
+}
+
+IRAM int safe(int x)
+{
+    dram[x & 3] = x;
+    return x;
+}
+
+IRAM void FCLEDTimer_ISR(void)
+{
+    dram[0] = helper(dram[1]) + safe(2);
+}
+
+void _start(void)
+{
+    FCLEDTimer_ISR();
+    flashfn(dram[2]);
+}
@@ -0,0 +1,430 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host test for the DMX recorder & player (fc_record.cpp)
+ *
+ * Build & run:
+ *   g++ -O2 -I host -o fcrecordtest fcrecordtest.cpp && ./fcrecordtest [-v]
+ *
+ * Compiles fc_record.cpp against an in-memory SD card, and runs the
+ * DMX loop side in 1ms steps on a virtual clock. The recorder task
+ * runs one iteration at a time: a given time after it was notified
+ * (the task latency), or when its flush timeout expires.
+ *
+ * A show is recorded, then played back over several loops. Checks
+ * per scenario: The output matches the recording at every step,
+ * where a change may be late by at most the task latency (only when
+ * the task has to open or rewind the file) plus one step. Over all
+ * scenarios, the loop side never touches the SD card, and the task
+ * holds the SD lock (sd_lock()) for every file operation. -v prints
+ * the firmware's serial output.
+ *
+ * Exits 1 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#define FC_HAVE_RECORDER
+#include "../fc-DMX/fc_record.cpp"
+
+#define CHANS   24
+
+// Virtual clock (ms)
+
+static unsigned long vnow;
+
+unsigned long millis()
+{
+    return vnow;
+}
+
+unsigned long micros()
+{
+    return vnow * 1000;
+}
+
+// SD model
+
+struct HostFile {
+    std::vector<uint8_t> data;
+};
+
+static std::map<std::string, HostFile> files;
+
+// The loop must never use the SD card, the task only with the SD
+// lock held (rec_setup() at boot needs none)
+static bool sdHeld, inTask, booted;
+static int  sdFaults, loopFaults;
+
+void sd_lock()
+{
+    if(sdHeld) sdFaults++;
+    sdHeld = true;
+}
+
+void sd_unlock()
+{
+    if(!sdHeld) sdFaults++;
+    sdHeld = false;
+}
+
+static void sd_access()
+{
+    if(inTask && !sdHeld) sdFaults++;
+    if(!inTask && booted) loopFaults++;
+}
+
+SDFS SD;
+
+bool SDFS::exists(const char *path)
+{
+    sd_access();
+    return files.count(path) > 0;
+}
+
+File SDFS::open(const char *path, const char *mode)
+{
+    File f;
+
+    sd_access();
+    if(!strcmp(mode, FILE_WRITE)) {
+        files[path].data.clear();
+    } else if(!files.count(path)) {
+        return f;
+    }
+    f.f = &files[path];
+    f.pos = 0;
+
+    return f;
+}
+
+bool SDFS::remove(const char *path)
+{
+    sd_access();
+    return files.erase(path) > 0;
+}
+
+bool SDFS::rename(const char *from, const char *to)
+{
+    sd_access();
+    if(!files.count(from))
+        return false;
+    files[to] = files[from];
+    files.erase(from);
+    return true;
+}
+
+File::operator bool() const
+{
+    return f != NULL;
+}
+
+size_t File::read(uint8_t *buf, size_t len)
+{
+    size_t n;
+
+    sd_access();
+    if(!f)
+        return 0;
+
+    n = min(len, f->data.size() - min((size_t)pos, f->data.size()));
+    memcpy(buf, f->data.data() + pos, n);
+    pos += n;
+
+    return n;
+}
+
+size_t File::write(const uint8_t *buf, size_t len)
+{
+    sd_access();
+    if(!f)
+        return 0;
+
+    f->data.insert(f->data.end(), buf, buf + len);
+    pos += len;
+
+    return len;
+}
+
+bool File::seek(uint32_t p)
+{
+    sd_access();
+    if(!f || p > f->data.size())
+        return false;
+    pos = p;
+    return true;
+}
+
+void File::flush()
+{
+    sd_access();
+}
+
+void File::close()
+{
+    sd_access();
+    f = NULL;
+}
+
+// Arduino, FreeRTOS, logger
+
+HardwareSerial Serial;
+static bool verbose;
+
+int HardwareSerial::printf(const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if(verbose) fputs(buf, stdout);
+
+    return n;
+}
+
+void HardwareSerial::println(const char *s)
+{
+    this->printf("%s\n", s);
+}
+
+static std::vector<uint8_t> logged;
+
+bool log_msg(uint8_t id, int32_t arg)
+{
+    if(verbose) printf("[log %d]\n", id);
+    logged.push_back(id);
+    return true;
+}
+
+bool haveSD = true;
+
+static void (*taskFunc)(void *);
+static int           notified;
+static int           takes;
+static unsigned long taskLat = 2;       // ms from notify to task run
+static unsigned long notifyTime, lastRun;
+
+struct TaskEnd { };
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *parm,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    taskFunc = fn;
+    *handle = (TaskHandle_t)&taskFunc;
+    return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    if(!notified) notifyTime = vnow;
+    notified++;
+}
+
+// Ends the task after one iteration
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    uint32_t res;
+
+    if(takes++)
+        throw TaskEnd();
+    res = notified;
+    notified = clear ? 0 : notified - 1;
+
+    return res;
+}
+
+// One step: the task if due, then the loop side
+
+static void step()
+{
+    if((notified && vnow - notifyTime >= taskLat) || vnow - lastRun >= REC_FLUSH_MS) {
+        inTask = true;
+        takes = 0;
+        try {
+            taskFunc(NULL);
+        } catch(TaskEnd&) { }
+        inTask = false;
+        lastRun = vnow;
+    }
+}
+
+// The show: every 25ms, some channels change
+
+struct Event {
+    unsigned long t;
+    uint8_t frame[CHANS];
+};
+
+static std::vector<Event> show;
+static unsigned long showLen;
+
+static void record(unsigned long len, int perStep)
+{
+    Event e = { 0 };
+    uint32_t lcg = len;
+    unsigned long start = vnow;
+
+    show.clear();
+    for(unsigned long t = 0; t < len; t++, vnow++) {
+        if(!(t % 25)) {
+            for(int i = 0; i < perStep; i++) {
+                lcg = lcg * 1664525 + 1013904223;
+                e.frame[(lcg >> 8) % CHANS] = lcg >> 24;
+            }
+            e.t = t;
+            show.push_back(e);
+            if(!t) rec_start(e.frame);
+            else   rec_frame(e.frame);
+        }
+        step();
+    }
+    rec_stop();
+    showLen = vnow - start;
+
+    // Until the task has closed the file
+    for(int i = 0; i <= REC_FLUSH_MS && rec_isRecording(); i++, vnow++) {
+        step();
+    }
+    while(!play_available() && vnow - start < len + 1000) {
+        vnow++;
+        step();
+    }
+}
+
+// Index of the last event at or before t (showLen-periodic)
+static size_t eventAt(unsigned long t)
+{
+    size_t i = show.size() - 1;
+
+    t %= showLen;
+    while(i && show[i].t > t) i--;
+
+    return i;
+}
+
+// Play for len ms. Returns the maximum lateness, or -1 if the
+// output doesn't match the show
+static long play(unsigned long len, unsigned long *base)
+{
+    uint8_t frame[CHANS] = { 0 };
+    bool    started = false;
+    long    late = 0;
+    size_t  cur = 0;
+
+    for(unsigned long end = vnow + len; vnow < end; vnow++) {
+        step();
+        if(play_loop(frame) && !started) {
+            started = true;
+            *base = vnow;
+        }
+        if(!started)
+            continue;
+
+        // The frame must show the current event, or an earlier one
+        // while it is late
+        unsigned long t = vnow - *base;
+        size_t now = eventAt(t);
+        if(!memcmp(frame, show[now].frame, CHANS)) {
+            cur = now;
+            continue;
+        }
+        if(memcmp(frame, show[cur].frame, CHANS))
+            return -1;
+        unsigned long due = (t / showLen) * showLen + show[(cur + 1) % show.size()].t;
+        if(t >= due && (long)(t - due + 1) > late)
+            late = t - due + 1;
+    }
+
+    return started ? late : -1;
+}
+
+// Scenarios
+
+static int failed;
+
+static void check(bool ok, const char *what)
+{
+    printf("  %-48s %s\n", what, ok ? "ok" : "FAIL");
+    if(!ok) failed++;
+}
+
+static void run(const char *name, unsigned long len, int perStep, unsigned long lat)
+{
+    char buf[128];
+    unsigned long base;
+    long late;
+
+    printf("%s\n", name);
+
+    taskLat = lat;
+    record(len, perStep);
+    check(play_available(), "Recording available");
+
+    play_start();
+    late = play(showLen * 3 + showLen / 2, &base);
+    snprintf(buf, sizeof(buf), "Output matches recording, 3 loops (late %ldms)", late);
+    check(late >= 0 && late <= (long)taskLat + 1, buf);
+
+    // Restart from the beginning
+    play_stop();
+    vnow += 10;
+    play_start();
+    late = play(showLen / 2, &base);
+    check(late >= 0 && late <= (long)taskLat + 1, "Restart plays from the beginning");
+    play_stop();
+
+    for(int i = 0; i <= REC_FLUSH_MS; i++, vnow++) {
+        step();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    verbose = (argc > 1 && !strcmp(argv[1], "-v"));
+
+    rec_setup(CHANS);
+    if(!taskFunc) {
+        printf("FAIL: rec_setup()\n");
+        return 1;
+    }
+    booted = true;
+
+    run("Sparse changes, 20s", 20000, 2, 2);
+    run("Every channel changes, 20s", 20000, CHANS, 2);
+    run("Every channel changes, task latency 100ms", 10000, CHANS, 100);
+
+    {
+        printf("Bad recording\n");
+        taskLat = 2;
+        files[REC_FILENAME].data[3] = REC_VERSION + 1;
+        logged.clear();
+        play_start();
+        for(int i = 0; i < 10; i++, vnow++) {
+            step();
+            uint8_t frame[CHANS];
+            play_loop(frame);
+        }
+        check(!play_isPlaying() && !play_available(), "Playback stops, recording unavailable");
+        check(std::find(logged.begin(), logged.end(), LOG_PLAY_BAD) != logged.end(), "Firmware reports it");
+    }
+
+    printf("All scenarios\n");
+    check(!loopFaults, "Loop never uses the SD card");
+    check(!sdFaults, "SD only used with the SD lock held");
+
+    printf(failed ? "%d check(s) failed\n" : "All checks passed\n", failed);
+
+    return failed ? 1 : 0;
+}
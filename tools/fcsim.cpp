@@ -0,0 +1,1186 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host simulator for the DMX loop and the FC LED timer (fc_dmx.cpp,
+ * fcdisplay.cpp)
+ *
+ * Build & run:
+ *   g++ -O2 -pthread -I host -o fcsim fcsim.cpp && (cd fcsim && ../fcsim *.fcs)
+ *   ./fcsim -t script.fcs      (serial port on a pty, see below)
+ *
+ * Runs dmx_boot(), dmx_setup() and dmx_loop() on a virtual clock; the
+ * hardware timers (FC LED chase, strobe) call their ISRs at their
+ * alarm times. DMX packets are fed from a script. The timeline holds
+ *   FC          every byte latched into the shift register (decoded
+ *               from the GPIO writes, or the SPI transfers if
+ *               FC_SR_USE_SPI is defined)
+ *   CLED, BLED  every change of the PWM duty cycle
+ *   CPU         CPU clock changes (FC_IDLE_POWERSAVE)
+ *   SER         serial output (text lines)
+ *   TX          serial output (binary, eg acks of injected frames)
+ * and is compared against the golden file next to the script
+ * (<script>.golden). -u writes the golden files, -p prints the
+ * timelines. Each script runs in a process of its own. The golden
+ * files are for fc_global.h as shipped, plus FC_HAVE_INJECT, which
+ * the simulator always builds with; other builds differ (eg with
+ * FC_SR_USE_SPI, the shift register is latched once more at boot).
+ *
+ * The loop and the ISRs take no virtual time. Time advances between
+ * calls of dmx_loop() (to the next packet, timer alarm or full
+ * millisecond, whichever comes first; the loop's decisions are all
+ * based on millis()), while dmx_receive_num() waits, and while serial
+ * output waits for the UART (see below). The ISRs therefore never
+ * interrupt the loop's code, other than while it waits.
+ *
+ * By default, tasks are not started (the logger then prints directly),
+ * and serial output takes no time. With "set tasks on", tasks run in
+ * threads of their own, but only one of them (or the loop) at a time:
+ * A task runs when its vTaskDelay() has expired, like a timer alarm,
+ * and until it waits again. With "set baud <n>", the UART's TX FIFO
+ * (UART_FIFO bytes) drains at n baud, and serial output waits for
+ * room in the FIFO, like Serial does without a TX buffer (the Arduino
+ * core's default). The stats then include the loop's longest run (not
+ * counting the wait in dmx_receive_num()), and the longest delay from
+ * a packet's arrival until the loop receives it.
+ *
+ * With -t, the serial port is a pty (its name is printed on stderr),
+ * eg for tools/fcinject.py, and the virtual clock is paced by the
+ * real clock. Input is read while waiting for the next step, and
+ * fed to the firmware at that step. The timeline is printed, not
+ * compared (it depends on the timing of the input).
+ *
+ * Script: One command per line, '#' starts a comment, times in ms
+ *   set <key> <value>    Before the first packet: address, personality,
+ *                        loss (hold|blackout), verify, cledfreq, bledfreq,
+ *                        tasks (on|off), baud
+ *   at <t>|+<t>          Set the script time (absolute or relative)
+ *   ch <n>=<v> ...       Set channels, relative to the FC's address
+ *   slot <n>=<v> ...     Set slots (0 = start code)
+ *   size <n>             Packet size incl. start code (default 513)
+ *   packet               Send one packet at script time
+ *   error <code>         Send a packet with a receive error
+ *   stream <p> <t>|+<t> [<code>]
+ *                        Send a packet (with a receive error, if code is
+ *                        given) every p ms from script time until t;
+ *                        script time then is t
+ *   replay <file>        Send the frames of a CSV file written by
+ *                        fcsniff.py (time in us, slots) from script time;
+ *                        script time then is the time of the last frame
+ *   inject <v> ...       Send a frame through the serial port (see
+ *                        fc_inject.cpp) with values for ch1.. at
+ *                        script time; the sequence number counts up
+ *   serial <hex> ...     Send bytes through the serial port at script
+ *                        time
+ *   log on|off           Record the timeline (default on)
+ *   stats                Record counts and intervals of updates since
+ *                        the last stats (counted also while log is off)
+ *   end <t>              Simulate until t
+ *
+ * Exits 1 if a timeline differs from its golden file.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include <SPI.h>
+#include <soc/spi_struct.h>
+
+#define FC_HAVE_INJECT
+
+#include "../fc-DMX/fc_dmx.cpp"
+#include "../fc-DMX/fcdisplay.cpp"
+#include "../fc-DMX/fc_log.cpp"
+#include "../fc-DMX/fc_latency.cpp"
+#include "../fc-DMX/fc_inject.cpp"
+
+#if defined(FC_HAVE_RECORDER) || defined(FC_HAVE_AUDIO) || defined(FC_HAVE_SNIFFER) || \
+    defined(FC_HAVE_SCENES) || defined(FC_LOOK_RESTORE)
+#error "fcsim: SD and NVS are not simulated"
+#endif
+
+#define NEVER   UINT64_MAX
+
+// Virtual clock (us)
+
+static uint64_t vnow;
+
+// Timeline
+
+static std::string timeline;
+static bool logOn = true;
+
+static struct {
+    uint64_t since;
+    uint32_t latches, ticks, packets;
+    uint32_t pwm[2];
+    uint64_t lastLatch, minInt, maxInt;
+    uint64_t loopMax, rxDelayMax;
+} st;
+
+static uint32_t uartBaud;
+
+static void event(const char *fmt, ...)
+{
+    char buf[160];
+    va_list args;
+    int n;
+
+    if(!logOn)
+        return;
+
+    n = snprintf(buf, sizeof(buf), "%8llu.%03llu ", (unsigned long long)(vnow / 1000),
+                                                   (unsigned long long)(vnow % 1000));
+    va_start(args, fmt);
+    vsnprintf(buf + n, sizeof(buf) - n, fmt, args);
+    va_end(args);
+    timeline += buf;
+    timeline += '\n';
+}
+
+static void stats()
+{
+    uint64_t span = vnow - st.since;
+    bool wasOn = logOn;
+
+    logOn = true;
+    event("STATS %.3fs: FC %lu latches (%.3f/s, interval %.3f-%.3f ms), %lu ticks, "
+          "CLED %lu, BLED %lu changes, %lu packets",
+          span / 1e6, (unsigned long)st.latches, span ? st.latches * 1e6 / span : 0.0,
+          st.minInt / 1e3, st.maxInt / 1e3, (unsigned long)st.ticks,
+          (unsigned long)st.pwm[0], (unsigned long)st.pwm[1], (unsigned long)st.packets);
+    if(uartBaud) {
+        event("STATS loop max %.3f ms, packet delay max %.3f ms", st.loopMax / 1e3,
+              st.rxDelayMax / 1e3);
+    }
+
+    logOn = wasOn;
+    memset(&st, 0, sizeof(st));
+    st.since = vnow;
+}
+
+// Shift register
+
+static void latch(uint8_t val)
+{
+    char bits[9];
+
+    for(int i = 0; i < 8; i++) bits[i] = '0' + ((val >> (7 - i)) & 1);
+    bits[8] = 0;
+    // Bits 7, 6 are not connected
+    event("FC %s", bits + 2);
+
+    if(st.latches) {
+        uint64_t i = vnow - st.lastLatch;
+        if(!st.minInt || i < st.minInt) st.minInt = i;
+        if(i > st.maxInt) st.maxInt = i;
+    }
+    st.latches++;
+    st.lastLatch = vnow;
+}
+
+// GPIO: 74HC595 clocks in SER on a rising SRCLK, latches on a
+// rising RCLK
+
+static uint8_t  pinLevel[40];
+static uint32_t srBits;
+
+static void setPin(uint8_t pin, uint8_t level)
+{
+    uint8_t old = pinLevel[pin];
+
+    pinLevel[pin] = level;
+    if(level && !old) {
+        if(pin == SHIFT_CLK_PIN) {
+            srBits = (srBits << 1) | pinLevel[SERDATA_PIN];
+        } else if(pin == REG_CLK_PIN) {
+            latch(srBits);
+        }
+    }
+}
+
+gpio_dev_t GPIO;
+
+void host_gpio_write(int reg, uint32_t val)
+{
+    int offs = (reg == HOST_GPIO_OUT1_W1TS || reg == HOST_GPIO_OUT1_W1TC) ? 32 : 0;
+    uint8_t level = (reg == HOST_GPIO_OUT_W1TS || reg == HOST_GPIO_OUT1_W1TS);
+
+    for(int i = 0; i < 32 && i + offs < 40; i++) {
+        if(val & (1UL << i)) setPin(i + offs, level);
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    setPin(pin, !!val);
+}
+
+// SPI (FC_SR_USE_SPI): The hardware CS latches after 8 bits;
+// transfers complete immediately
+
+spi_dev_t SPI2, SPI3;
+
+void host_spi_start(volatile spi_dev_s *dev)
+{
+    latch(dev->data_buf[0]);
+}
+
+bool host_spi_busy(volatile spi_dev_s *dev)
+{
+    return false;
+}
+
+SPIClass::SPIClass(uint8_t bus) { }
+void SPIClass::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss) { }
+void SPIClass::setHwCs(bool use) { }
+void SPIClass::setFrequency(uint32_t freq) { }
+void SPIClass::setDataMode(uint8_t mode) { }
+void SPIClass::setBitOrder(uint8_t order) { }
+
+void SPIClass::write(uint8_t data)
+{
+    latch(data);
+}
+
+// LEDC
+
+static int ledcDuty[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+
+double ledcSetup(uint8_t chan, double freq, uint8_t res)
+{
+    return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t chan)
+{
+}
+
+uint32_t ledcChangeFrequency(uint8_t chan, uint32_t freq, uint8_t res)
+{
+    return freq;
+}
+
+void ledcWrite(uint8_t chan, uint32_t duty)
+{
+    if((int)duty == ledcDuty[chan])
+        return;
+
+    ledcDuty[chan] = duty;
+    event("%s %lu", chan == CLED_CHANNEL ? "CLED" : (chan == BLED_CHANNEL ? "BLED" : "LEDC?"),
+                    (unsigned long)duty);
+    if(chan < 2) st.pwm[chan]++;
+}
+
+// Timers: 80MHz APB clock / divider; on an alarm, the ISR is called,
+// and with auto-reload, the next alarm is the (possibly updated) alarm
+// value later
+
+struct hw_timer_s {
+    uint16_t divider;
+    uint64_t alarm;
+    bool     autoreload;
+    bool     enabled;
+    uint64_t next;
+    void     (*fn)();
+};
+
+static hw_timer_t timers[4];
+
+static uint64_t timerPeriod(hw_timer_t *t)
+{
+    uint64_t us = t->alarm * t->divider / 80;
+    return us ? us : 1;
+}
+
+static uint64_t nextAlarm(hw_timer_t **which = NULL)
+{
+    uint64_t next = NEVER;
+
+    for(int i = 0; i < 4; i++) {
+        if(timers[i].enabled && timers[i].next < next) {
+            next = timers[i].next;
+            if(which) *which = &timers[i];
+        }
+    }
+
+    return next;
+}
+
+static void realtime(uint64_t t);
+static uint64_t nextTask(struct Task **which = NULL);
+static void runTask(struct Task *task);
+
+static void advance_to(uint64_t t)
+{
+    hw_timer_t *tmr = NULL;
+    struct Task *task = NULL;
+
+    realtime(t);
+
+    // Timer alarms and tasks in time order (an alarm first)
+    for(;;) {
+        uint64_t alarm = nextAlarm(&tmr), wake = nextTask(&task);
+        if(min(alarm, wake) > t)
+            break;
+        if(wake < alarm) {
+            if(wake > vnow) vnow = wake;
+            runTask(task);
+            continue;
+        }
+        vnow = tmr->next;
+        if(tmr == &timers[FC_TIMER_NO]) st.ticks++;
+        if(tmr->fn) tmr->fn();
+        if(tmr->autoreload) {
+            tmr->next += timerPeriod(tmr);
+        } else {
+            tmr->enabled = false;
+        }
+    }
+    if(t > vnow) vnow = t;
+}
+
+hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp)
+{
+    timers[num].divider = divider;
+    return &timers[num];
+}
+
+void timerAttachInterrupt(hw_timer_t *timer, void (*fn)(), bool edge)
+{
+    timer->fn = fn;
+}
+
+void timerAttachInterruptFlag(hw_timer_t *timer, void (*fn)(), bool edge, int flags)
+{
+    timer->fn = fn;
+}
+
+void timerAlarmWrite(hw_timer_t *timer, uint64_t alarm, bool autoreload)
+{
+    timer->alarm = alarm;
+    timer->autoreload = autoreload;
+}
+
+void timerAlarmEnable(hw_timer_t *timer)
+{
+    if(!timer->enabled) {
+        timer->enabled = true;
+        timer->next = vnow + timerPeriod(timer);
+    }
+}
+
+void timerAlarmDisable(hw_timer_t *timer)
+{
+    timer->enabled = false;
+}
+
+void timerWrite(hw_timer_t *timer, uint64_t val)
+{
+    timer->next = vnow + timerPeriod(timer) - val * timer->divider / 80;
+}
+
+// Arduino, FreeRTOS
+
+unsigned long millis()
+{
+    return vnow / 1000;
+}
+
+unsigned long micros()
+{
+    return vnow;
+}
+
+int64_t esp_timer_get_time()
+{
+    return vnow;
+}
+
+void delay(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+static uint32_t cpuMhz = 240;
+
+bool setCpuFrequencyMhz(uint32_t mhz)
+{
+    cpuMhz = mhz;
+    event("CPU %lu MHz", (unsigned long)mhz);
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz()
+{
+    return cpuMhz;
+}
+
+void portENTER_CRITICAL(portMUX_TYPE *mux) { }
+void portEXIT_CRITICAL(portMUX_TYPE *mux) { }
+void portENTER_CRITICAL_ISR(portMUX_TYPE *mux) { }
+void portEXIT_CRITICAL_ISR(portMUX_TYPE *mux) { }
+
+// Tasks (set tasks on): A thread each; whoever holds "running" runs,
+// the others wait on taskCv
+
+struct Task {
+    void     (*fn)(void *);
+    void     *parm;
+    uint64_t wake;
+};
+
+static bool tasksOn;
+static std::vector<Task *> tasks;
+static Task *running;                   // NULL: the loop
+static thread_local Task *self;         // NULL: the loop
+static std::mutex taskMtx;
+static std::condition_variable taskCv;
+
+static uint64_t nextTask(Task **which)
+{
+    uint64_t next = NEVER;
+
+    for(size_t i = 0; i < tasks.size(); i++) {
+        if(tasks[i]->wake < next) {
+            next = tasks[i]->wake;
+            if(which) *which = tasks[i];
+        }
+    }
+
+    return next;
+}
+
+// Loop: Let the task run until it waits
+static void runTask(Task *task)
+{
+    std::unique_lock<std::mutex> lock(taskMtx);
+
+    task->wake = NEVER;
+    running = task;
+    taskCv.notify_all();
+    taskCv.wait(lock, [] { return !running; });
+}
+
+// Task: Wait until t, let the loop run meanwhile
+static void taskWait(uint64_t t)
+{
+    std::unique_lock<std::mutex> lock(taskMtx);
+    Task *me = self;
+
+    me->wake = t;
+    running = NULL;
+    taskCv.notify_all();
+    taskCv.wait(lock, [me] { return running == me; });
+}
+
+static void taskMain(Task *task)
+{
+    {
+        std::unique_lock<std::mutex> lock(taskMtx);
+        self = task;
+        taskCv.wait(lock, [task] { return running == task; });
+    }
+    task->fn(task->parm);
+}
+
+// Not started unless tasks are on: The logger then prints directly
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *parm,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    Task *task;
+
+    if(!tasksOn)
+        return pdFALSE;
+
+    task = new Task { fn, parm, vnow };
+    tasks.push_back(task);
+    std::thread(taskMain, task).detach();
+    if(handle) *handle = (TaskHandle_t)task;
+
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if(self) {
+        taskWait(vnow + (uint64_t)ticks * 1000);
+    } else {
+        advance_to(vnow + (uint64_t)ticks * 1000);
+    }
+}
+
+// UART (set baud <n>): Wait for room in the TX FIFO, queue len bytes
+
+#define UART_FIFO   128
+
+static double uartDone;         // when the last queued byte is sent (us)
+
+static void uartSend(size_t len)
+{
+    double byteUs;
+
+    if(!uartBaud)
+        return;
+
+    byteUs = 10e6 / uartBaud;
+    while(len--) {
+        double room = uartDone - UART_FIFO * byteUs;
+        if(room > vnow) {
+            if(self) taskWait((uint64_t)ceil(room));
+            else     advance_to((uint64_t)ceil(room));
+        }
+        uartDone = max(uartDone, (double)vnow) + byteUs;
+    }
+}
+
+// Serial port: Input from the script, or from the pty (-t)
+
+struct SerialIn {
+    uint64_t t;
+    uint8_t  b;
+};
+
+HardwareSerial Serial;
+static std::string serialLine;
+static std::deque<SerialIn> serialIn;
+static int ptyFd = -1;
+static std::chrono::steady_clock::time_point realStart;
+
+static uint64_t nextSerial()
+{
+    return serialIn.size() ? serialIn.front().t : NEVER;
+}
+
+// -t: Wait until virtual time t is due; input arriving in the
+// meantime is fed at t
+static void realtime(uint64_t t)
+{
+    uint8_t buf[256];
+    int64_t left;
+    ssize_t n;
+
+    if(ptyFd < 0)
+        return;
+
+    do {
+        struct pollfd pfd = { ptyFd, POLLIN, 0 };
+        left = (int64_t)t - std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - realStart).count();
+        if(poll(&pfd, 1, left > 0 ? (left + 999) / 1000 : 0) > 0 &&
+           (n = read(ptyFd, buf, sizeof(buf))) > 0) {
+            for(ssize_t i = 0; i < n; i++) {
+                SerialIn in = { t, buf[i] };
+                serialIn.push_back(in);
+            }
+        }
+    } while(left > 0);
+}
+
+// Output is dropped while nobody reads the pty
+static void ptyWrite(const void *buf, size_t len)
+{
+    if(ptyFd >= 0) {
+        ssize_t res = write(ptyFd, buf, len);
+        (void)res;
+    }
+}
+
+static void ptyOpen()
+{
+    struct termios tio;
+    int slave;
+
+    if((ptyFd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(ptyFd) || unlockpt(ptyFd) ||
+       (slave = open(ptsname(ptyFd), O_RDWR | O_NOCTTY)) < 0) {
+        perror("fcsim: pty");
+        exit(2);
+    }
+    fcntl(ptyFd, F_SETFL, O_NONBLOCK);
+
+    // Raw mode; the slave is kept open, so clients can come and go
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    fprintf(stderr, "fcsim: serial port %s\n", ptsname(ptyFd));
+}
+
+int HardwareSerial::read()
+{
+    int b;
+
+    if(nextSerial() > vnow)
+        return -1;
+
+    b = serialIn.front().b;
+    serialIn.pop_front();
+
+    return b;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len)
+{
+    char hex[3 * 64 + 1];
+    size_t i;
+
+    ptyWrite(buf, len);
+
+    for(i = 0; i < len && i < 64; i++) {
+        sprintf(hex + i * 3, " %02x", buf[i]);
+    }
+    event("TX%s", hex);
+    uartSend(len);
+
+    return len;
+}
+
+int HardwareSerial::printf(const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+    size_t nl;
+
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    ptyWrite(buf, strlen(buf));
+
+    serialLine += buf;
+    while((nl = serialLine.find('\n')) != std::string::npos) {
+        event("SER %s", serialLine.substr(0, nl).c_str());
+        serialLine.erase(0, nl + 1);
+    }
+    uartSend(strlen(buf));
+
+    return n;
+}
+
+void HardwareSerial::print(const char *s)
+{
+    this->printf("%s", s);
+}
+
+void HardwareSerial::println(const char *s)
+{
+    this->printf("%s\n", s);
+}
+
+struct Settings settings = {
+    DEF_DMX_ADDRESS,
+    DEF_DMX_PERSONALITY,
+    DEF_LOSS_POLICY,
+    DEF_USE_VERIFY,
+    DEF_MONITOR,
+    DEF_CLED_FREQ,
+    DEF_BLED_FREQ
+};
+
+bool haveSD = false;
+
+// DMX driver: Packets from the script
+
+struct Packet {
+    std::vector<uint8_t> slots;
+    int size;
+    int err;
+};
+
+struct Stream {
+    uint64_t next, period, end;
+    int pkt;
+};
+
+struct Single {
+    uint64_t t;
+    int pkt;
+};
+
+static std::vector<Packet> packets;
+static std::vector<Stream> streams;
+static std::vector<Single> singles;
+static size_t singlePos;
+static const Packet *curPkt;
+static uint64_t rxWaited;
+static uint8_t dmxPers = DMX_PERS_STD;
+
+static uint64_t nextPacket(int *src = NULL)
+{
+    uint64_t next = NEVER;
+
+    for(size_t i = 0; i < streams.size(); i++) {
+        if(streams[i].next < streams[i].end && streams[i].next < next) {
+            next = streams[i].next;
+            if(src) *src = i;
+        }
+    }
+    if(singlePos < singles.size() && singles[singlePos].t < next) {
+        next = singles[singlePos].t;
+        if(src) *src = -1;
+    }
+
+    return next;
+}
+
+size_t dmx_receive_num(dmx_port_t port, dmx_packet_t *packet, size_t num, uint32_t wait)
+{
+    int src;
+
+    if(nextPacket() > vnow) {
+        if(!wait)
+            return 0;
+        uint64_t t0 = vnow;
+        advance_to(min(nextPacket(), vnow + (uint64_t)wait * 1000));
+        rxWaited += vnow - t0;
+        if(nextPacket() > vnow)
+            return 0;
+    }
+
+    st.rxDelayMax = max(st.rxDelayMax, vnow - nextPacket(&src));
+    if(src < 0) {
+        curPkt = &packets[singles[singlePos++].pkt];
+    } else {
+        curPkt = &packets[streams[src].pkt];
+        streams[src].next += streams[src].period;
+    }
+    st.packets++;
+
+    packet->err = curPkt->err;
+    packet->sc = curPkt->slots[0];
+    packet->size = min(num, (size_t)curPkt->size);
+    packet->is_rdm = false;
+
+    return packet->size;
+}
+
+int dmx_read_slot(dmx_port_t port, size_t slot)
+{
+    return (curPkt && slot < (size_t)curPkt->size) ? curPkt->slots[slot] : 0;
+}
+
+size_t dmx_read_offset(dmx_port_t port, size_t offset, void *dst, size_t size)
+{
+    if(!curPkt || offset >= (size_t)curPkt->size)
+        return 0;
+    size = min(size, curPkt->size - offset);
+    memcpy(dst, &curPkt->slots[offset], size);
+    return size;
+}
+
+bool dmx_driver_install(dmx_port_t port, dmx_config_t *config, dmx_personality_t *pers, int count)
+{
+    return true;
+}
+
+bool dmx_set_pin(dmx_port_t port, int tx, int rx, int rts)
+{
+    return true;
+}
+
+bool dmx_set_start_address(dmx_port_t port, uint16_t addr)
+{
+    return true;
+}
+
+bool dmx_set_current_personality(dmx_port_t port, uint8_t pers)
+{
+    dmxPers = pers;
+    return true;
+}
+
+uint8_t dmx_get_current_personality(dmx_port_t port)
+{
+    return dmxPers;
+}
+
+// Script
+
+#define MARK_LOG_ON     0
+#define MARK_LOG_OFF    1
+#define MARK_STATS      2
+
+struct Marker {
+    uint64_t t;
+    int what;
+};
+
+static std::vector<Marker> markers;
+static size_t markerPos;
+static uint64_t endTime;
+
+static const char *scriptName;
+static int lineNo;
+
+static void fail(const char *fmt, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "%s:%d: ", scriptName, lineNo);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(2);
+}
+
+static uint64_t parseTime(const char *s, uint64_t base)
+{
+    char *end;
+    double ms;
+
+    if(!s) fail("time missing");
+    if(*s == '+') {
+        ms = strtod(s + 1, &end);
+    } else {
+        ms = strtod(s, &end);
+        base = 0;
+    }
+    if(end == s || *end || ms < 0) fail("bad time \"%s\"", s);
+
+    return base + (uint64_t)(ms * 1000 + 0.5);
+}
+
+static long parseNum(const char *s, long minVal, long maxVal)
+{
+    char *end;
+    long n;
+
+    if(!s) fail("value missing");
+    n = strtol(s, &end, 0);
+    if(end == s || *end || n < minVal || n > maxVal) fail("bad value \"%s\"", s);
+
+    return n;
+}
+
+static int addPacket(const Packet &p)
+{
+    packets.push_back(p);
+    return packets.size() - 1;
+}
+
+static void replay(const char *fn, uint64_t &at)
+{
+    FILE *f = fopen(fn, "r");
+    char line[4096];
+    uint64_t t0 = 0, t = 0;
+    bool first = true;
+
+    if(!f) fail("can't open %s", fn);
+
+    while(fgets(line, sizeof(line), f)) {
+        Packet p = { std::vector<uint8_t>(DMX_PACKET_SIZE), 0, DMX_OK };
+        char *tok = strtok(line, ",\r\n");
+        if(!tok)
+            continue;
+        t = strtoull(tok, NULL, 10);
+        if(first) {
+            t0 = t;
+            first = false;
+        }
+        while((tok = strtok(NULL, ",\r\n")) && p.size < DMX_PACKET_SIZE) {
+            p.slots[p.size++] = atoi(tok);
+        }
+        Single s = { at + t - t0, addPacket(p) };
+        singles.push_back(s);
+    }
+    fclose(f);
+
+    at += t - t0;
+}
+
+static void addSerial(uint64_t t, const uint8_t *buf, int len)
+{
+    for(int i = 0; i < len; i++) {
+        SerialIn in = { t, buf[i] };
+        serialIn.push_back(in);
+    }
+}
+
+static void loadScript(const char *fn)
+{
+    FILE *f = fopen(fn, "r");
+    char line[1024];
+    uint8_t ser[2 + 2 + INJ_MAXLEN + 2];
+    uint8_t injSeqNo = 0;
+    uint64_t at = 0;
+    Packet cur = { std::vector<uint8_t>(DMX_PACKET_SIZE), DMX_PACKET_SIZE, DMX_OK };
+    bool sent = false;
+
+    scriptName = fn;
+    if(!f) fail("can't open");
+
+    while(fgets(line, sizeof(line), f)) {
+        char *t, *cmd, *arg;
+
+        lineNo++;
+        if((t = strchr(line, '#'))) *t = 0;
+        if(!(cmd = strtok(line, " \t\r\n")))
+            continue;
+        arg = strtok(NULL, " \t\r\n");
+
+        if(!strcmp(cmd, "set")) {
+            char *val = strtok(NULL, " \t\r\n");
+            if(sent) fail("set after first packet");
+            if(!arg || !val) fail("set <key> <value>");
+            if(!strcmp(arg, "address")) settings.dmxAddress = parseNum(val, 1, 512);
+            else if(!strcmp(arg, "personality")) settings.personality = parseNum(val, 1, DMX_PERS_MAX);
+            else if(!strcmp(arg, "loss") && !strcmp(val, "hold")) settings.lossPolicy = LOSS_HOLD;
+            else if(!strcmp(arg, "loss") && !strcmp(val, "blackout")) settings.lossPolicy = LOSS_BLACKOUT;
+            else if(!strcmp(arg, "verify")) settings.useVerify = parseNum(val, 0, 1);
+            else if(!strcmp(arg, "cledfreq")) settings.cledFreq = parseNum(val, 100, 40000);
+            else if(!strcmp(arg, "bledfreq")) settings.bledFreq = parseNum(val, 100, 40000);
+            else if(!strcmp(arg, "tasks")) tasksOn = !strcmp(val, "on");
+            else if(!strcmp(arg, "baud")) uartBaud = parseNum(val, 300, 5000000);
+            else fail("bad setting \"%s\"", arg);
+        } else if(!strcmp(cmd, "at")) {
+            at = parseTime(arg, at);
+        } else if(!strcmp(cmd, "ch") || !strcmp(cmd, "slot")) {
+            int base = (*cmd == 'c') ? settings.dmxAddress - 1 : 0;
+            for(; arg; arg = strtok(NULL, " \t\r\n")) {
+                char *eq = strchr(arg, '=');
+                if(!eq) fail("expected <n>=<v>");
+                *eq = 0;
+                long n = base + parseNum(arg, base ? 1 : 0, DMX_CHANNELS);
+                if(!base) n = parseNum(arg, 0, DMX_PACKET_SIZE - 1);
+                if(n >= DMX_PACKET_SIZE) fail("slot %ld beyond the universe", n);
+                cur.slots[n] = parseNum(eq + 1, 0, 255);
+            }
+        } else if(!strcmp(cmd, "size")) {
+            cur.size = parseNum(arg, 1, DMX_PACKET_SIZE);
+        } else if(!strcmp(cmd, "packet") || !strcmp(cmd, "error")) {
+            Packet p = cur;
+            if(*cmd == 'e') p.err = parseNum(arg, 1, 255);
+            Single s = { at, addPacket(p) };
+            singles.push_back(s);
+            sent = true;
+        } else if(!strcmp(cmd, "stream")) {
+            uint64_t period = parseTime(arg, 0);
+            uint64_t end = parseTime(strtok(NULL, " \t\r\n"), at);
+            char *code = strtok(NULL, " \t\r\n");
+            Packet p = cur;
+            if(!period) fail("period must not be 0");
+            if(code) p.err = parseNum(code, 1, 255);
+            Stream s = { at, period, end, addPacket(p) };
+            streams.push_back(s);
+            at = end;
+            sent = true;
+        } else if(!strcmp(cmd, "replay")) {
+            replay(arg ? arg : "", at);
+            sent = true;
+        } else if(!strcmp(cmd, "inject")) {
+            uint16_t crc;
+            int len = 4;
+            for(; arg; arg = strtok(NULL, " \t\r\n")) {
+                if(len >= 4 + INJ_MAXLEN) fail("more than %d values", INJ_MAXLEN);
+                ser[len++] = parseNum(arg, 0, 255);
+            }
+            if(len == 4) fail("values missing");
+            ser[0] = INJ_SYNC1;
+            ser[1] = INJ_SYNC2;
+            ser[2] = injSeqNo++;
+            ser[3] = len - 4;
+            crc = 0xffff;
+            for(int i = 2; i < len; i++) crc = crc16(crc, ser[i]);
+            ser[len++] = crc & 0xff;
+            ser[len++] = crc >> 8;
+            addSerial(at, ser, len);
+        } else if(!strcmp(cmd, "serial")) {
+            int len = 0;
+            for(; arg; arg = strtok(NULL, " \t\r\n")) {
+                char *end;
+                long b = strtol(arg, &end, 16);
+                if(end == arg || *end || b < 0 || b > 255) fail("bad byte \"%s\"", arg);
+                if(len >= (int)sizeof(ser)) {
+                    addSerial(at, ser, len);
+                    len = 0;
+                }
+                ser[len++] = b;
+            }
+            addSerial(at, ser, len);
+        } else if(!strcmp(cmd, "log")) {
+            Marker m = { at, (arg && !strcmp(arg, "off")) ? MARK_LOG_OFF : MARK_LOG_ON };
+            markers.push_back(m);
+        } else if(!strcmp(cmd, "stats")) {
+            Marker m = { at, MARK_STATS };
+            markers.push_back(m);
+        } else if(!strcmp(cmd, "end")) {
+            endTime = parseTime(arg, at);
+        } else {
+            fail("unknown command \"%s\"", cmd);
+        }
+    }
+    fclose(f);
+
+    if(!endTime) fail("no end");
+
+    std::stable_sort(singles.begin(), singles.end(),
+                     [](const Single &a, const Single &b) { return a.t < b.t; });
+    std::stable_sort(serialIn.begin(), serialIn.end(),
+                     [](const SerialIn &a, const SerialIn &b) { return a.t < b.t; });
+    std::stable_sort(markers.begin(), markers.end(),
+                     [](const Marker &a, const Marker &b) { return a.t < b.t; });
+}
+
+static uint64_t nextMarker()
+{
+    return markerPos < markers.size() ? markers[markerPos].t : NEVER;
+}
+
+static void runMarkers()
+{
+    while(nextMarker() <= vnow) {
+        switch(markers[markerPos++].what) {
+        case MARK_LOG_ON:  logOn = true;  break;
+        case MARK_LOG_OFF: logOn = false; break;
+        case MARK_STATS:   stats();       break;
+        }
+    }
+}
+
+static void simulate()
+{
+    dmx_boot();
+    dmx_setup();
+
+    while(vnow < endTime) {
+        runMarkers();
+        uint64_t t0 = vnow;
+        rxWaited = 0;
+        dmx_loop();
+        st.loopMax = max(st.loopMax, vnow - t0 - rxWaited);
+        uint64_t t = (vnow / 1000 + 1) * 1000;
+        t = min(t, nextPacket());
+        t = min(t, nextSerial());
+        t = min(t, nextAlarm());
+        t = min(t, nextMarker());
+        t = min(t, endTime);
+        advance_to(t);
+    }
+    runMarkers();
+}
+
+static int runScript(const char *fn, bool update, bool print, bool real)
+{
+    std::string golden = std::string(fn, strlen(fn) - (strstr(fn, ".fcs") ? 4 : 0)) + ".golden";
+    FILE *out = (print || real) ? stderr : stdout;
+
+    loadScript(fn);
+
+    if(real) {
+        ptyOpen();
+    }
+
+    auto start = realStart = std::chrono::steady_clock::now();
+    simulate();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(out, "%s: %.1fs simulated in %.2fs: ", fn, endTime / 1e6, secs);
+
+    if(print || real) {
+        fputs(timeline.c_str(), stdout);
+    }
+
+    if(real) {
+        fprintf(out, "done\n");
+        return 0;
+    }
+
+    if(update) {
+        FILE *f = fopen(golden.c_str(), "w");
+        if(!f || fwrite(timeline.data(), 1, timeline.size(), f) != timeline.size()) {
+            fprintf(out, "can't write %s\n", golden.c_str());
+            return 2;
+        }
+        fclose(f);
+        fprintf(out, "%s written\n", golden.c_str());
+        return 0;
+    }
+
+    FILE *f = fopen(golden.c_str(), "r");
+    if(!f) {
+        fprintf(out, "no %s\n", golden.c_str());
+        return 1;
+    }
+    std::string exp;
+    char buf[4096];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), f))) exp.append(buf, n);
+    fclose(f);
+
+    if(exp == timeline) {
+        fprintf(out, "ok\n");
+        return 0;
+    }
+
+    // Report first difference
+    size_t pos = 0, line = 1;
+    while(pos < exp.size() && pos < timeline.size() && exp[pos] == timeline[pos]) {
+        if(exp[pos++] == '\n') line++;
+    }
+    size_t ls = exp.rfind('\n', pos ? pos - 1 : 0);
+    ls = (ls == std::string::npos || !pos) ? 0 : ls + 1;
+    fprintf(out, "FAIL at line %zu\n  expected: %s\n  got:      %s\n", line,
+            exp.substr(ls, exp.find('\n', ls) - ls).c_str(),
+            timeline.substr(ls, timeline.find('\n', ls) - ls).c_str());
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    bool update = false, print = false, real = false;
+    int res = 0, i;
+
+    for(i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if(!strcmp(argv[i], "-u")) update = true;
+        else if(!strcmp(argv[i], "-p")) print = true;
+        else if(!strcmp(argv[i], "-t")) real = true;
+        else break;
+    }
+    if(i >= argc || (real && (update || i != argc - 1))) {
+        fprintf(stderr, "usage: fcsim [-u] [-p] script.fcs ...\n"
+                        "       fcsim -t script.fcs\n");
+        return 2;
+    }
+
+    // The firmware's state can't be reset: One process per script
+    for(; i < argc; i++) {
+        int status;
+        pid_t pid = fork();
+        if(!pid) {
+            // Task threads still wait on taskCv: Don't run destructors
+            int ret = runScript(argv[i], update, print, real);
+            fflush(stdout);
+            fflush(stderr);
+            _exit(ret);
+        }
+        fflush(stdout);
+        if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+            res = 1;
+        }
+    }
+
+    return res;
+}
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+#
+# -------------------------------------------------------------------
+# CircuitSetup.us Flux Capacitor - DMX-controlled
+# (C) 2024 Thomas Winischhofer (A10001986)
+# All rights reserved.
+# -------------------------------------------------------------------
+#
+# Decoder for the FC's DMX monitor mode. Requires firmware built with
+# FC_HAVE_SNIFFER, "monitor = 1" in the config file, and pyserial.
+#
+# Examples:
+#   fcsniff.py /dev/ttyUSB0
+#       Print changed slots of every frame, and statistics every 5s
+#   fcsniff.py /dev/ttyUSB0 --csv frames.csv
+#       Also write all full frames (timestamp, slot 0-512) to a file
+#   fcsniff.py capture.bin
+#       Decode a capture of the serial output from a file
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = b"\xfc\x5e"
+KEY, ERROR, TIMING, RAW = 0x01, 0x02, 0x04, 0x08
+SLOTS = 513
+
+
+def varint(buf, pos):
+    val = shift = 0
+    while True:
+        b = buf[pos]
+        pos += 1
+        val |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return val, pos
+
+
+class Decoder:
+
+    def __init__(self):
+        self.frame = bytearray(SLOTS)
+        self.synced = False
+        self.last_dropped = None
+        self.reset_stats()
+
+    def reset_stats(self):
+        self.frames = self.errors = self.raw = self.dropped = self.bad = 0
+        self.breaks = []
+        self.mabs = []
+
+    def record(self, payload):
+        """Decode one record; returns (flags, timestamp, size, changes) or None"""
+        flags, ts, size, dropped = struct.unpack_from("<BIHH", payload)
+        pos = 9
+        if self.last_dropped is not None:
+            self.dropped += (dropped - self.last_dropped) & 0xFFFF
+        self.last_dropped = dropped
+        if flags & TIMING:
+            brk, mab = struct.unpack_from("<HH", payload, pos)
+            self.breaks.append(brk)
+            self.mabs.append(mab)
+            pos += 4
+        if flags & ERROR:
+            self.errors += 1
+            return flags, ts, size, []
+        if flags & RAW:
+            self.raw += 1
+            return flags, ts, size, []
+        if flags & KEY:
+            self.frame[:] = bytes(SLOTS)
+            self.synced = True
+        elif not self.synced:
+            return None
+        self.frames += 1
+        changes = []
+        slot = 0
+        while pos < len(payload):
+            skip, pos = varint(payload, pos)
+            count, pos = varint(payload, pos)
+            slot += skip
+            for i in range(count):
+                if self.frame[slot + i] != payload[pos + i]:
+                    changes.append((slot + i, payload[pos + i]))
+                self.frame[slot + i] = payload[pos + i]
+            slot += count
+            pos += count
+        self.frame[size:] = bytes(SLOTS - size)
+        return flags, ts, size, changes
+
+
+def records(src):
+    """Yield record payloads found in the byte stream, skipping text output"""
+    buf = bytearray()
+    while True:
+        data = src()
+        if data is None:
+            return
+        buf += data
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                del buf[:-1]
+                break
+            if len(buf) - i < 4:
+                del buf[:i]
+                break
+            plen = buf[i + 2] | (buf[i + 3] << 8)
+            if plen > 2 * SLOTS + 32:
+                del buf[:i + 2]
+                continue
+            if len(buf) - i < 4 + plen + 1:
+                del buf[:i]
+                break
+            payload = bytes(buf[i + 4:i + 4 + plen])
+            if sum(payload) & 0xFF == buf[i + 4 + plen]:
+                yield payload
+                del buf[:i + 4 + plen + 1]
+            else:
+                yield None
+                del buf[:i + 2]
+
+
+def print_stats(dec, secs):
+    line = "-- %d frames, %d errors, %d other start codes, %d records dropped, %d corrupt" % (
+        dec.frames, dec.errors, dec.raw, dec.dropped, dec.bad)
+    if dec.breaks:
+        line += ", break %d-%d us, MAB %d-%d us" % (
+            min(dec.breaks), max(dec.breaks), min(dec.mabs), max(dec.mabs))
+    print(line + " (last %.0fs)" % secs)
+    dec.reset_stats()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Decode the FC's DMX monitor output")
+    ap.add_argument("port", help="serial port or capture file")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--csv", help="write all frames to this file")
+    ap.add_argument("--quiet", action="store_true", help="only print statistics")
+    args = ap.parse_args()
+
+    try:
+        import serial
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        src = lambda: port.read(4096)
+    except (ImportError, ValueError, OSError):
+        f = open(args.port, "rb")
+        src = lambda: f.read(4096) or None
+
+    csv = open(args.csv, "w") if args.csv else None
+    dec = Decoder()
+    last_stats = time.monotonic()
+
+    for payload in records(src):
+        if payload is None:
+            # Frame content unknown until next key record
+            dec.bad += 1
+            dec.synced = False
+            continue
+        res = dec.record(payload)
+        if res is None:
+            continue
+        flags, ts, size, changes = res
+        if flags & ERROR:
+            print("%10.6f DMX error %d" % (ts / 1e6, size))
+        elif flags & RAW:
+            print("%10.6f Start code 0x%02x, %d slots" % (ts / 1e6, payload[-size], size))
+        else:
+            if changes and not args.quiet:
+                print("%10.6f %s" % (ts / 1e6, " ".join("%d=%d" % c for c in changes)))
+            if csv:
+                csv.write("%d,%s\n" % (ts, ",".join(str(v) for v in dec.frame)))
+
+        now = time.monotonic()
+        if now - last_stats >= 5:
+            print_stats(dec, now - last_stats)
+            last_stats = now
+
+    print_stats(dec, time.monotonic() - last_stats)
+
+
+if __name__ == "__main__":
+    main()
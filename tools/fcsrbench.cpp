@@ -0,0 +1,167 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host benchmark for the FC LED shift register output (fcdisplay.cpp)
+ *
+ * Build & run, once per backend:
+ *   g++ -O2 -I host -o fcsrbench fcsrbench.cpp && ./fcsrbench
+ *   g++ -O2 -I host -DFC_SR_USE_SPI -o fcsrbench fcsrbench.cpp && ./fcsrbench
+ *
+ * Runs the FC LED timer ISR for one minute of timer ticks per chase
+ * setting, and counts the latches and the peripheral register
+ * accesses the ISR makes for them: GPIO set/clear writes when bit-
+ * banging; with FC_SR_USE_SPI, SPI register writes and busy polls.
+ * The SPI transfer (8 bits at FC_SPI_FREQ) is modelled on the tick
+ * clock, so a poll finds the peripheral busy only if the previous
+ * transfer is still running (each poll takes one APB cycle).
+ *
+ * The refresh rate (latches/s) is set by the timer tick and the
+ * chase, and is the same for both backends. What differs is the ISR
+ * time per latch: On the ESP32, every register access goes over the
+ * APB bus (80MHz), so each takes at least one APB cycle (12.5ns);
+ * the bound printed is that minimum, not a measured time.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../fc-DMX/fcdisplay.cpp"
+
+#define BENCH_TICKS   6000      // 60s at TMR_TIME
+#define APB_NS        12.5
+
+static double   vnow;           // us
+static uint32_t latches, accesses, polls;
+static uint32_t ticks;
+#ifdef FC_SR_USE_SPI
+static double   spiDone;
+#endif
+
+// GPIO; a rising RCLK latches
+
+gpio_dev_t GPIO;
+
+void host_gpio_write(int reg, uint32_t val)
+{
+    accesses++;
+    if((reg == HOST_GPIO_OUT_W1TS) && (val & (1UL << REG_CLK_PIN))) {
+        latches++;
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) { }
+void digitalWrite(uint8_t pin, uint8_t val) { }
+
+#ifdef FC_SR_USE_SPI
+// SPI: The data register write and the start are one access each
+
+spi_dev_t SPI2, SPI3;
+
+void host_spi_start(volatile spi_dev_s *dev)
+{
+    accesses += 2;
+    latches++;
+    spiDone = vnow + 8 * 1e6 / FC_SPI_FREQ;
+}
+
+// Each poll takes an APB cycle
+bool host_spi_busy(volatile spi_dev_s *dev)
+{
+    accesses++;
+    polls++;
+    vnow += APB_NS / 1000;
+    return vnow < spiDone;
+}
+
+SPIClass::SPIClass(uint8_t bus) { }
+void SPIClass::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss) { }
+void SPIClass::setHwCs(bool use) { }
+void SPIClass::setFrequency(uint32_t freq) { }
+void SPIClass::setDataMode(uint8_t mode) { }
+void SPIClass::setBitOrder(uint8_t order) { }
+void SPIClass::write(uint8_t data) { }
+#endif
+
+// Timer: Only the ISR is kept, the bench calls it
+
+static void (*isr)();
+static hw_timer_t *theTimer = (hw_timer_t *)&isr;
+
+hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp) { return theTimer; }
+void timerAttachInterruptFlag(hw_timer_t *timer, void (*fn)(), bool edge, int flags) { isr = fn; }
+void timerAlarmWrite(hw_timer_t *timer, uint64_t alarm, bool autoreload) { }
+void timerAlarmEnable(hw_timer_t *timer) { }
+void timerAlarmDisable(hw_timer_t *timer) { }
+void timerWrite(hw_timer_t *timer, uint64_t val) { }
+
+// LEDC (strobe part of fcdisplay.cpp, unused here)
+
+double   ledcSetup(uint8_t chan, double freq, uint8_t res) { return freq; }
+void     ledcAttachPin(uint8_t pin, uint8_t chan) { }
+void     ledcWrite(uint8_t chan, uint32_t duty) { }
+uint32_t ledcChangeFrequency(uint8_t chan, uint32_t freq, uint8_t res) { return freq; }
+void     timerAttachInterrupt(hw_timer_t *timer, void (*fn)(), bool edge) { }
+
+unsigned long millis() { return vnow / 1000; }
+unsigned long micros() { return vnow; }
+
+void portENTER_CRITICAL(portMUX_TYPE *mux) { }
+void portEXIT_CRITICAL(portMUX_TYPE *mux) { }
+void portENTER_CRITICAL_ISR(portMUX_TYPE *mux) { }
+void portEXIT_CRITICAL_ISR(portMUX_TYPE *mux) { }
+
+HardwareSerial Serial;
+int HardwareSerial::printf(const char *fmt, ...) { return 0; }
+bool log_msg(uint8_t id, int32_t arg) { return true; }
+
+static FCLEDs fcLEDs(0, SHIFT_CLK_PIN, REG_CLK_PIN, SERDATA_PIN, MRESET_PIN);
+
+static void run(const char *name)
+{
+    latches = accesses = polls = 0;
+
+    for(int i = 0; i < BENCH_TICKS; i++) {
+        vnow = (double)++ticks * TME_TIMEUS;
+        isr();
+    }
+
+    double secs = BENCH_TICKS * TMR_TIME;
+    printf("%-22s %7.1f latches/s, %5.1f accesses/latch", name,
+           latches / secs, latches ? (double)accesses / latches : 0.0);
+    #ifdef FC_SR_USE_SPI
+    printf(" (%.1f polls)", latches ? (double)polls / latches : 0.0);
+    #endif
+    printf(", >= %4.0f ns/latch, >= %6.1f us/s\n",
+           latches ? accesses * APB_NS / latches : 0.0, accesses * APB_NS / 1000 / secs);
+}
+
+int main()
+{
+    #ifdef FC_SR_USE_SPI
+    printf("Backend: SPI (%d Hz)\n", FC_SPI_FREQ);
+    #else
+    printf("Backend: bit-bang\n");
+    #endif
+
+    fcLEDs.begin();
+    fcLEDs.on();
+    isr();
+
+    fcLEDs.setSequence(0);
+    fcLEDs.setSpeed(2);
+    run("chase, fastest");
+
+    fcLEDs.setSpeed(20);
+    run("chase, slowest");
+
+    fcLEDs.setGenerator(FCGEN_PARAMS(FCGEN_SINE, 128, 0));
+    fcLEDs.setSpeed(2);
+    run("generator, fastest");
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stubs: Declarations of the parts of the Arduino core, ESP-IDF
+ * and FreeRTOS the firmware uses, so firmware modules can be built
+ * on the host (see tools/fcaudiotest.cpp, tools/fcsim.cpp). Each host
+ * program defines the functions it needs; time is virtual.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define F(x) x
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   1
+#define OUTPUT  3
+
+#define ESP_INTR_FLAG_LEVEL2    (1<<2)
+#define ESP_INTR_FLAG_LEVEL3    (1<<3)
+#define ESP_INTR_FLAG_EDGE      (1<<9)
+#define ESP_INTR_FLAG_IRAM      (1<<10)
+
+typedef int esp_err_t;
+#define ESP_OK                          0
+#define ESP_FAIL                        -1
+#define ESP_ERR_INVALID_SIZE            0x104
+#define ESP_ERR_TIMEOUT                 0x107
+#define ESP_ERR_NVS_NOT_FOUND           0x1102
+#define ESP_ERR_NVS_NO_FREE_PAGES       0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   0x1110
+
+unsigned long millis();
+unsigned long micros();
+int64_t esp_timer_get_time();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+uint32_t esp_random();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+
+double   ledcSetup(uint8_t chan, double freq, uint8_t res);
+void     ledcAttachPin(uint8_t pin, uint8_t chan);
+void     ledcWrite(uint8_t chan, uint32_t duty);
+uint32_t ledcChangeFrequency(uint8_t chan, uint32_t freq, uint8_t res);
+
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void     timerEnd(hw_timer_t *timer);
+void     timerAttachInterrupt(hw_timer_t *timer, void (*fn)(), bool edge);
+void     timerAttachInterruptFlag(hw_timer_t *timer, void (*fn)(), bool edge, int flags);
+void     timerDetachInterrupt(hw_timer_t *timer);
+void     timerAlarmWrite(hw_timer_t *timer, uint64_t alarm, bool autoreload);
+void     timerAlarmEnable(hw_timer_t *timer);
+void     timerAlarmDisable(hw_timer_t *timer);
+bool     timerAlarmEnabled(hw_timer_t *timer);
+void     timerWrite(hw_timer_t *timer, uint64_t val);
+uint64_t timerRead(hw_timer_t *timer);
+void     timerStart(hw_timer_t *timer);
+void     timerStop(hw_timer_t *timer);
+void     timerRestart(hw_timer_t *timer);
+
+bool     setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+
+int gpio_install_isr_service(int flags);
+
+struct HardwareSerial {
+    void   begin(unsigned long baud);
+    void   end();
+    void   updateBaudRate(unsigned long baud);
+    void   setRxBufferSize(size_t size);
+    void   setTxBufferSize(size_t size);
+    void   print(const char *s);
+    void   println(const char *s = "");
+    int    printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    int    available();
+    int    availableForWrite();
+    int    read();
+    size_t readBytes(uint8_t *buf, size_t len);
+    size_t write(uint8_t b);
+    size_t write(const uint8_t *buf, size_t len);
+    void   flush();
+};
+extern HardwareSerial Serial;
+
+struct EspClass {
+    void     restart();
+    uint32_t getCpuFreqMHz();
+    uint32_t getCycleCount();
+};
+extern EspClass ESP;
+
+// FreeRTOS
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void    *TaskHandle_t;
+typedef void    *SemaphoreHandle_t;
+typedef void    *QueueHandle_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define portMAX_DELAY       0xffffffff
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(x)    (x)
+#define portYIELD_FROM_ISR(x)
+
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack, void *parm, 
+                       UBaseType_t prio, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *parm, 
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+void       vTaskDelay(TickType_t ticks);
+uint32_t   ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void       xTaskNotifyGive(TaskHandle_t task);
+void       vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+typedef struct { int lock; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+void portENTER_CRITICAL(portMUX_TYPE *mux);
+void portEXIT_CRITICAL(portMUX_TYPE *mux);
+void portENTER_CRITICAL_ISR(portMUX_TYPE *mux);
+void portEXIT_CRITICAL_ISR(portMUX_TYPE *mux);
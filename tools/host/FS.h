@@ -0,0 +1,35 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+struct HostFile;
+
+struct File {
+    HostFile *f = NULL;
+    uint32_t  pos = 0;
+
+    operator bool() const;
+    size_t read(uint8_t *buf, size_t len);
+    int    read();
+    size_t write(const uint8_t *buf, size_t len);
+    size_t size();
+    bool   seek(uint32_t pos);
+    size_t position();
+    int    available();
+    void   flush();
+    void   close();
+};
@@ -0,0 +1,25 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Preferences {
+    bool    begin(const char *ns, bool readOnly = false);
+    void    end();
+    size_t  getBytesLength(const char *key);
+    size_t  getBytes(const char *key, void *buf, size_t len);
+    size_t  putBytes(const char *key, const void *buf, size_t len);
+    uint8_t getUChar(const char *key, uint8_t def = 0);
+    size_t  putUChar(const char *key, uint8_t val);
+    bool    remove(const char *key);
+};
@@ -0,0 +1,30 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define CARD_NONE       0
+#define CARD_UNKNOWN    4
+
+struct SPIClass;
+
+struct SDFS {
+    bool    begin(int cs, SPIClass &spi, uint32_t freq);
+    void    end();
+    uint8_t cardType();
+    bool    exists(const char *path);
+    File    open(const char *path, const char *mode = FILE_READ);
+    bool    remove(const char *path);
+    bool    rename(const char *from, const char *to);
+};
+extern SDFS SD;
@@ -0,0 +1,29 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define HSPI        2
+#define VSPI        3
+#define SPI_MODE0   0
+#define MSBFIRST    1
+
+struct SPIClass {
+    SPIClass(uint8_t bus = VSPI);
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1);
+    void setHwCs(bool use);
+    void setFrequency(uint32_t freq);
+    void setDataMode(uint8_t mode);
+    void setBitOrder(uint8_t order);
+    void write(uint8_t data);
+};
+extern SPIClass SPI;
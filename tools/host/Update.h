@@ -0,0 +1,26 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UPDATE_SIZE_UNKNOWN 0xffffffff
+
+struct UpdateClass {
+    bool   begin(uint32_t size);
+    size_t write(uint8_t *data, size_t len);
+    bool   end(bool evenIfRemaining = false);
+    bool   hasError();
+    int    getError();
+    void   abort();
+};
+extern UpdateClass Update;
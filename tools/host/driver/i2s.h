@@ -0,0 +1,53 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+typedef int i2s_port_t;
+typedef int i2s_mode_t;
+
+#define I2S_NUM_0           0
+#define I2S_MODE_MASTER     1
+#define I2S_MODE_TX         4
+#define I2S_PIN_NO_CHANGE   -1
+
+typedef enum { I2S_BITS_PER_SAMPLE_16BIT = 16 } i2s_bits_per_sample_t;
+typedef enum { I2S_CHANNEL_MONO = 1, I2S_CHANNEL_STEREO = 2 } i2s_channel_t;
+typedef enum { I2S_CHANNEL_FMT_RIGHT_LEFT } i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1 } i2s_comm_format_t;
+
+typedef struct {
+    i2s_mode_t            mode;
+    uint32_t              sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t     channel_format;
+    i2s_comm_format_t     communication_format;
+    int                   intr_alloc_flags;
+    int                   dma_buf_count;
+    int                   dma_buf_len;
+    bool                  use_apll;
+    bool                  tx_desc_auto_clear;
+} i2s_config_t;
+
+typedef struct {
+    int mck_io_num;
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t *cfg, int qsize, void *queue);
+esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t *pins);
+esp_err_t i2s_set_clk(i2s_port_t port, uint32_t rate, uint32_t bits, i2s_channel_t ch);
+esp_err_t i2s_write(i2s_port_t port, const void *src, size_t size, size_t *written, TickType_t wait);
+esp_err_t i2s_zero_dma_buffer(i2s_port_t port);
@@ -0,0 +1,106 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h (esp_dmx v4 API subset)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DMX_PACKET_SIZE                 513
+#define DMX_INTR_FLAGS_DEFAULT          0
+#define DMX_TIMEOUT_TICK                0xffffffff
+#define RDM_PRODUCT_CATEGORY_FIXTURE    0x0100
+
+#define DMX_OK          0
+
+typedef int dmx_port_t;
+typedef int dmx_err_t;
+
+typedef struct {
+    dmx_err_t err;
+    int       sc;
+    size_t    size;
+    bool      is_rdm;
+} dmx_packet_t;
+
+typedef struct {
+    int         interrupt_flags;
+    int         root_device_parameter_count;
+    int         sub_device_parameter_count;
+    int         model_id;
+    int         product_category;
+    int         software_version_id;
+    const char *software_version_label;
+    int         queue_size_max;
+} dmx_config_t;
+
+typedef struct {
+    uint16_t    footprint;
+    const char *description;
+} dmx_personality_t;
+
+typedef struct {
+    int32_t break_len;
+    int32_t mab_len;
+} dmx_metadata_t;
+
+// RDM responder (custom parameters)
+
+#define RDM_SUB_DEVICE_ROOT             0
+#define RDM_DS_NOT_DEFINED              0x00
+#define RDM_CC_GET                      0x20
+
+typedef uint16_t rdm_pid_t;
+typedef uint16_t rdm_sub_device_t;
+typedef int      rdm_ds_t;
+typedef int      rdm_pid_cc_t;
+
+typedef struct {
+    uint8_t cc;
+    rdm_pid_t pid;
+} rdm_header_t;
+
+typedef struct {
+    rdm_ds_t     data_type;
+    rdm_pid_cc_t cc;
+    size_t       alloc_size;
+    const char  *format;
+} rdm_pd_schema_t;
+
+struct rdm_pd_definition_t;
+typedef size_t (*rdm_response_handler_t)(dmx_port_t port, const struct rdm_pd_definition_t *def,
+                                         const rdm_header_t *header);
+typedef void (*rdm_callback_t)(dmx_port_t port, const rdm_header_t *req, rdm_header_t *resp, void *ctx);
+
+typedef struct rdm_pd_definition_t {
+    rdm_pid_t              pid;
+    rdm_pd_schema_t        schema;
+    bool                   nvs;
+    rdm_response_handler_t response_handler;
+} rdm_pd_definition_t;
+
+size_t rdm_simple_response_handler(dmx_port_t port, const rdm_pd_definition_t *def, const rdm_header_t *header);
+bool   rdm_register_parameter(dmx_port_t port, rdm_sub_device_t sub, const rdm_pd_definition_t *def,
+                              void *data, rdm_callback_t cb, void *ctx);
+size_t rdm_set_parameter(dmx_port_t port, rdm_sub_device_t sub, rdm_pid_t pid, const void *data, size_t size);
+
+bool     dmx_driver_install(dmx_port_t port, dmx_config_t *config, dmx_personality_t *pers, int count);
+bool     dmx_set_pin(dmx_port_t port, int tx, int rx, int rts);
+size_t   dmx_receive(dmx_port_t port, dmx_packet_t *packet, uint32_t wait);
+size_t   dmx_receive_num(dmx_port_t port, dmx_packet_t *packet, size_t num, uint32_t wait);
+size_t   dmx_read(dmx_port_t port, void *dst, size_t size);
+size_t   dmx_read_offset(dmx_port_t port, size_t offset, void *dst, size_t size);
+int      dmx_read_slot(dmx_port_t port, size_t slot);
+uint8_t  dmx_get_current_personality(dmx_port_t port);
+bool     dmx_set_current_personality(dmx_port_t port, uint8_t pers);
+uint16_t dmx_get_start_address(dmx_port_t port);
+bool     dmx_set_start_address(dmx_port_t port, uint16_t addr);
+bool     dmx_sniffer_enable(dmx_port_t port, int pin);
+bool     dmx_sniffer_get_data(dmx_port_t port, dmx_metadata_t *meta, uint32_t wait);
@@ -0,0 +1,36 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ *
+ * Writes to the set/clear registers are handed to host_gpio_write(),
+ * which the host program defines (see tools/fcsim.cpp).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define HOST_GPIO_OUT_W1TS  0
+#define HOST_GPIO_OUT_W1TC  1
+#define HOST_GPIO_OUT1_W1TS 2
+#define HOST_GPIO_OUT1_W1TC 3
+
+void host_gpio_write(int reg, uint32_t val);
+
+template<int R> struct gpio_wreg_t {
+    void operator=(uint32_t v) volatile { host_gpio_write(R, v); }
+};
+
+typedef volatile struct gpio_dev_s {
+    gpio_wreg_t<HOST_GPIO_OUT_W1TS>  out_w1ts;
+    gpio_wreg_t<HOST_GPIO_OUT_W1TC>  out_w1tc;
+    struct { gpio_wreg_t<HOST_GPIO_OUT1_W1TS> val; } out1_w1ts;
+    struct { gpio_wreg_t<HOST_GPIO_OUT1_W1TC> val; } out1_w1tc;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
@@ -0,0 +1,45 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Flux Capacitor - DMX-controlled
+ * (C) 2024 Thomas Winischhofer (A10001986)
+ * All rights reserved.
+ * -------------------------------------------------------------------
+ *
+ * Host stub, see Arduino.h
+ *
+ * Setting cmd.usr hands the device to host_spi_start(), reading it
+ * asks host_spi_busy(); the host program defines both (see
+ * tools/fcsim.cpp).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct spi_dev_s;
+
+void host_spi_start(volatile spi_dev_s *dev);
+bool host_spi_busy(volatile spi_dev_s *dev);
+
+struct spi_usr_t {
+    inline void operator=(uint32_t v) volatile;
+    inline operator uint32_t() const volatile;
+};
+
+typedef volatile struct spi_dev_s {
+    struct { spi_usr_t usr; } cmd;
+    uint32_t data_buf[16];
+} spi_dev_t;
+
+// cmd.usr is the first member of the device
+inline void spi_usr_t::operator=(uint32_t v) volatile
+{
+    if(v) host_spi_start((volatile spi_dev_s *)this);
+}
+
+inline spi_usr_t::operator uint32_t() const volatile
+{
+    return host_spi_busy((volatile spi_dev_s *)this);
+}
+
+extern spi_dev_t SPI2, SPI3;